@@ -0,0 +1,56 @@
+#ifndef POINT_CLOUD_PROC_CLOUD_VIEW_H
+#define POINT_CLOUD_PROC_CLOUD_VIEW_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PCLPointCloud2.h>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// The points of cloud picked by indices, or all points when indices is null.
+// Stages pass views instead of copying the points out, both have to outlive
+// the view.
+struct CloudView {
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    explicit CloudView(const CloudT &cloud, const std::vector<int> *indices = NULL) :
+            cloud(&cloud), indices(indices) {}
+
+    size_t size() const { return indices ? indices->size() : cloud->points.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    const PointT &operator[](size_t i) const { return cloud->points[indices ? (*indices)[i] : i]; }
+
+    const CloudT *cloud;
+    const std::vector<int> *indices;
+};
+
+// Centroid and bounding box of the points of view in one pass, returns false
+// for an empty view
+bool computeBounds(const CloudView &view, Eigen::Vector3f &centroid, Eigen::Vector3f &min, Eigen::Vector3f &max);
+
+// Centroid and covariance, normalized by the number of points, of the points
+// of view
+bool computeCovariance(const CloudView &view, Eigen::Vector3d &centroid, Eigen::Matrix3d &covariance);
+
+// Serializes the points of view with the fields pcl::toPCLPointCloud2 gives
+// the whole cloud, as an unorganized cloud
+void toPCLPointCloud2(const CloudView &view, pcl::PCLPointCloud2 &msg);
+
+// Keeps only the points of cloud in indices, in place and in the order of
+// indices. indices have to be strictly ascending, every point is moved down
+// before it can be overwritten.
+void keepIndices(pcl::PointCloud<pcl::PointXYZRGB> &cloud, const std::vector<int> &indices);
+
+// Removes the points of cloud in indices in place, the other points keep
+// their order. indices have to be sorted, duplicates are allowed.
+void removeIndices(pcl::PointCloud<pcl::PointXYZRGB> &cloud, const std::vector<int> &indices);
+
+}
+
+#endif //POINT_CLOUD_PROC_CLOUD_VIEW_H
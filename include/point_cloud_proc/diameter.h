@@ -0,0 +1,36 @@
+#ifndef POINT_CLOUD_PROC_DIAMETER_H
+#define POINT_CLOUD_PROC_DIAMETER_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+
+namespace point_cloud_proc {
+
+enum DiameterMethod {
+    DIAMETER_PCL,       // pcl::getMaxSegment, all pairs of points
+    DIAMETER_HULL,      // exact, all pairs of convex hull vertices
+    DIAMETER_APPROX     // extreme points along sampled directions
+};
+
+bool diameterMethodFromString(const std::string &name, DiameterMethod &method);
+
+// Farthest pair of points of cloud, returns their distance and fills pmin and
+// pmax like pcl::getMaxSegment. DIAMETER_HULL gives the same distance as
+// getMaxSegment in O(n log n + h^2) for h hull vertices. DIAMETER_APPROX
+// takes the extreme points along directions sampled on a grid that has one
+// direction within acos(1 - max_error) of every direction, so the result is
+// at least (1 - max_error) * D for the true diameter D, in O(n / max_error).
+// The error bound is relative, max_error is not a distance.
+double computeDiameter(const pcl::PointCloud<pcl::PointXYZRGB> &cloud, DiameterMethod method,
+                       pcl::PointXYZRGB &pmin, pcl::PointXYZRGB &pmax, float max_error = 0.01f);
+
+// libqhull behind pcl::ConvexHull keeps its state in globals, every hull of
+// the package is computed under this lock
+boost::mutex &qhullMutex();
+
+}
+
+#endif //POINT_CLOUD_PROC_DIAMETER_H
@@ -0,0 +1,117 @@
+#ifndef POINT_CLOUD_PROC_FUSED_FILTER_H
+#define POINT_CLOUD_PROC_FUSED_FILTER_H
+
+#include <point_cloud_proc/voxel_hash_grid.h>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <Eigen/Geometry>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Where the fields of a point are in a raw buffer of width * height points,
+// offsets in bytes from the start of a point, -1 for a missing field
+struct PointBufferLayout {
+    uint32_t width, height, point_step, row_step;
+    int x_offset, y_offset, z_offset, rgb_offset;
+};
+
+// Offset of the field called name, -1 when there is none. Works on the
+// fields of sensor_msgs::PointCloud2 and pcl::PCLPointCloud2.
+template<typename FieldsT>
+int pointFieldOffset(const FieldsT &fields, const std::string &name) {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (fields[i].name == name) {
+            return fields[i].offset;
+        }
+    }
+    return -1;
+}
+
+// Front end of the pipeline in a single pass over a raw point buffer:
+// every point is transformed, tested against the pass-through box and binned
+// into its voxel of a VoxelHashGrid. Voxels are the same cells pcl::VoxelGrid
+// uses, with VOXEL_COLOR_AVERAGE the output matches VoxelGrid with all data
+// downsampled.
+class FusedFilter {
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+public:
+    FusedFilter();
+
+    void setTransform(const Eigen::Affine3f &transform);
+
+    // x_min, x_max, y_min, y_max, z_min, z_max in the target frame
+    void setLimits(const std::vector<float> &limits);
+
+    void setLeafSize(float leaf_size);
+
+    void setVoxelMode(VoxelMode mode);
+
+    // Points of data laid out as layout, x, y and z must be floats and rgb
+    // a packed uint32
+    bool filter(const uint8_t *data, const PointBufferLayout &layout, CloudT &cloud_out);
+
+    // Points of a message with the layout of sensor_msgs::PointCloud2 or
+    // pcl::PCLPointCloud2
+    template<typename CloudMsgT>
+    bool filter(const CloudMsgT &cloud_in, CloudT &cloud_out) {
+        PointBufferLayout layout;
+        layout.width = cloud_in.width;
+        layout.height = cloud_in.height;
+        layout.point_step = cloud_in.point_step;
+        layout.row_step = cloud_in.row_step;
+        layout.x_offset = pointFieldOffset(cloud_in.fields, "x");
+        layout.y_offset = pointFieldOffset(cloud_in.fields, "y");
+        layout.z_offset = pointFieldOffset(cloud_in.fields, "z");
+        layout.rgb_offset = pointFieldOffset(cloud_in.fields, "rgb");
+        if (layout.rgb_offset < 0) {
+            layout.rgb_offset = pointFieldOffset(cloud_in.fields, "rgba");
+        }
+        return filter(cloud_in.data.empty() ? NULL : &cloud_in.data[0], layout, cloud_out);
+    }
+
+private:
+    static const size_t BATCH_SIZE = 256;
+
+    void processBatch(size_t n);
+
+    float matrix_[12];
+    std::vector<float> limits_;
+
+    // Kept between frames so the steady state does not allocate
+    VoxelHashGrid voxel_grid_;
+
+    // Points are transformed and cropped in batches of separate x, y, z
+    // arrays by transformCropPoints()
+    float batch_x_[BATCH_SIZE], batch_y_[BATCH_SIZE], batch_z_[BATCH_SIZE];
+    uint32_t batch_rgb_[BATCH_SIZE];
+    uint8_t batch_keep_[BATCH_SIZE];
+};
+
+// Keeps the points inside limits = {x_min, x_max, y_min, y_max, z_min, z_max},
+// equivalent to pcl::PassThrough on x, y and z. cloud_in and cloud_out can be
+// the same cloud.
+void cropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const std::vector<float> &limits,
+                    pcl::PointCloud<pcl::PointXYZRGB> &cloud_out);
+
+// Keeps the points whose entry in inside is non zero, in order. cloud_in and
+// cloud_out can be the same cloud.
+void cropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const std::vector<uint8_t> &inside,
+                    pcl::PointCloud<pcl::PointXYZRGB> &cloud_out);
+
+// pcl::transformPointCloud with the kernel of FusedFilter, the points keep
+// their order and image grid. The crop test comes with the transform:
+// inside[i] is 1 when point i of cloud_out is inside limits and 0 otherwise,
+// NaN points never are. cloud_in and cloud_out can be the same cloud.
+void transformCropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const Eigen::Affine3f &transform,
+                             const std::vector<float> &limits, pcl::PointCloud<pcl::PointXYZRGB> &cloud_out,
+                             std::vector<uint8_t> &inside);
+
+}
+
+#endif //POINT_CLOUD_PROC_FUSED_FILTER_H
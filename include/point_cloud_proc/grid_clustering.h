@@ -0,0 +1,71 @@
+#ifndef POINT_CLOUD_PROC_GRID_CLUSTERING_H
+#define POINT_CLOUD_PROC_GRID_CLUSTERING_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace point_cloud_proc {
+
+enum ClusterMethod {
+    CLUSTER_KDTREE,         // pcl::EuclideanClusterExtraction
+    CLUSTER_GRID,           // GridClustering
+    CLUSTER_ORGANIZED       // extractOrganizedClusters() on the image grid
+};
+
+bool clusterMethodFromString(const std::string &name, ClusterMethod &method);
+
+// Euclidean clustering on a hashed grid instead of one radius search per
+// point. Cells are small enough that all points in a cell are within the
+// tolerance of each other, so a cell is one node of a union-find. Two cells
+// are joined as soon as one pair of their points is within the tolerance,
+// pairs of cells already in the same component are skipped. Gives the same
+// clusters as pcl::EuclideanClusterExtraction: sorted by size, largest
+// first, with sorted indices, clusters outside the size limits are dropped.
+class GridClustering {
+public:
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    GridClustering();
+
+    void setClusterTolerance(float tolerance);
+
+    void setMinClusterSize(int min_size);
+
+    void setMaxClusterSize(int max_size);
+
+    void setInputCloud(const CloudT::ConstPtr &cloud);
+
+    // Only the points in indices are clustered, all points when null
+    void setIndices(const pcl::PointIndices::ConstPtr &indices);
+
+    void extract(std::vector<pcl::PointIndices> &clusters);
+
+private:
+    int findRoot(int cell);
+
+    bool cellsConnected(int a, int b) const;
+
+    CloudT::ConstPtr cloud_;
+    pcl::PointIndices::ConstPtr indices_;
+    float tolerance_;
+    int min_size_, max_size_;
+
+    // Buffers reused between calls: points sorted by cell key, the first
+    // entry and coordinates of every cell, the cell lookup and the parents
+    std::vector<std::pair<uint64_t, int> > entries_;
+    std::vector<int> cell_start_;
+    std::vector<int> cell_coords_;
+    std::unordered_map<uint64_t, int> cell_map_;
+    std::vector<int> parent_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_GRID_CLUSTERING_H
@@ -0,0 +1,41 @@
+#ifndef POINT_CLOUD_PROC_LATENCY_STATS_H
+#define POINT_CLOUD_PROC_LATENCY_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace point_cloud_proc {
+
+struct LatencySummary {
+    uint64_t count = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+// Latency samples in milliseconds. count, mean and max cover every sample,
+// the percentiles the last window samples, a window of 0 keeps all of them.
+// Not thread-safe.
+class LatencyStats {
+public:
+    explicit LatencyStats(size_t window = 0);
+
+    void add(double ms);
+
+    void reset();
+
+    LatencySummary summary() const;
+
+private:
+    size_t window_, next_;
+    std::vector<double> samples_;
+    uint64_t count_;
+    double sum_ms_, max_ms_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_LATENCY_STATS_H
@@ -0,0 +1,88 @@
+#ifndef POINT_CLOUD_PROC_NORMAL_ENGINE_H
+#define POINT_CLOUD_PROC_NORMAL_ENGINE_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/search/kdtree.h>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// What a cloud was made from: the sensor message, kept alive so its address
+// can not be reused by another one, and the transform applied to it. Clouds
+// made the same way from the same source hold the same points. A source
+// without message never matches another one.
+struct NormalSource {
+    NormalSource() : transform(Eigen::Matrix4f::Identity()) {}
+
+    NormalSource(const boost::shared_ptr<const void> &message, const Eigen::Matrix4f &transform) :
+            message(message), transform(transform) {}
+
+    bool matches(const NormalSource &other) const {
+        return message && message == other.message && transform == other.transform;
+    }
+
+    boost::shared_ptr<const void> message;
+    Eigen::Matrix<float, 4, 4, Eigen::DontAlign> transform;
+};
+
+// Normal estimation for a whole cloud with one search index and a fixed
+// number of threads. The normals of the last cloud are kept: another call
+// for a cloud of the same source and size with the same neighbourhood and
+// indices returns them without recomputing, parts of the cloud slice them
+// with sliceNormals(). Not thread-safe, callers sharing an engine hold a
+// lock around compute(). Instantiated for pcl::PointXYZ and
+// pcl::PointXYZRGB.
+template <typename PointT>
+class NormalEngine {
+public:
+    typedef pcl::PointCloud<PointT> CloudT;
+    typedef pcl::PointCloud<pcl::Normal> CloudNT;
+
+    NormalEngine();
+
+    // 0 uses all cores
+    void setNumberOfThreads(int threads);
+
+    void setKSearch(int k);
+
+    // Normals of the points in indices, or of all points when indices is
+    // null. The result has one normal per point of cloud, NaN outside of
+    // indices. Neighbours are only searched among the points in indices,
+    // the normals are those of the extracted points. The result is never
+    // modified by a later call, it stays valid as long as it is held.
+    typename CloudNT::ConstPtr compute(const typename CloudT::ConstPtr &cloud,
+                                       const pcl::PointIndices::ConstPtr &indices = pcl::PointIndices::ConstPtr(),
+                                       const NormalSource &source = NormalSource());
+
+    // Forgets the cached normals
+    void invalidate();
+
+private:
+    pcl::NormalEstimationOMP<PointT, pcl::Normal> ne_;
+    typename pcl::search::KdTree<PointT>::Ptr tree_;
+    typename CloudNT::Ptr normals_, partial_normals_;
+    int threads_, k_;
+
+    // Identifies the cloud the cached normals were computed for, indices_
+    // is empty when they were computed for all points
+    bool valid_, all_points_;
+    NormalSource source_;
+    uint32_t width_, height_;
+    int cached_k_;
+    std::vector<int> indices_;
+};
+
+// The normals of the points in indices out of normals computed for their
+// whole cloud
+void sliceNormals(const pcl::PointCloud<pcl::Normal> &normals, const std::vector<int> &indices,
+                  pcl::PointCloud<pcl::Normal> &sliced);
+
+}
+
+#endif //POINT_CLOUD_PROC_NORMAL_ENGINE_H
@@ -0,0 +1,44 @@
+#ifndef POINT_CLOUD_PROC_ORGANIZED_CLUSTERING_H
+#define POINT_CLOUD_PROC_ORGANIZED_CLUSTERING_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/segmentation/comparator.h>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Joins two neighbouring pixels of an organized cloud when both are in the
+// mask and within the distance threshold of each other
+class MaskedEuclideanComparator : public pcl::Comparator<pcl::PointXYZRGB> {
+public:
+    typedef boost::shared_ptr<MaskedEuclideanComparator> Ptr;
+    typedef boost::shared_ptr<const MaskedEuclideanComparator> ConstPtr;
+
+    MaskedEuclideanComparator();
+
+    // One entry per pixel, non zero for pixels that can be joined
+    void setMask(const std::vector<uint8_t> &mask);
+
+    void setDistanceThreshold(float threshold);
+
+    virtual bool compare(int idx1, int idx2) const;
+
+private:
+    std::vector<uint8_t> mask_;
+    float sqr_threshold_;
+};
+
+// Connected components of the pixels in indices on the image grid of an
+// organized cloud, without any search structure. Clusters are sorted by
+// size, largest first, like pcl::EuclideanClusterExtraction, and hold pixel
+// indices row * width + col of cloud.
+void extractOrganizedClusters(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                              const std::vector<int> &indices, float tolerance, int min_size, int max_size,
+                              std::vector<pcl::PointIndices> &clusters);
+
+}
+
+#endif //POINT_CLOUD_PROC_ORGANIZED_CLUSTERING_H
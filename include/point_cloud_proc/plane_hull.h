@@ -0,0 +1,81 @@
+#ifndef POINT_CLOUD_PROC_PLANE_HULL_H
+#define POINT_CLOUD_PROC_PLANE_HULL_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Planar convex hull and polygonal prism without qhull. computeHull() runs
+// a monotone chain on the points projected to the plane. setHull() takes a
+// planar hull like pcl::ExtractPolygonalPrismData: the plane is fitted to
+// the hull points and its normal points to the viewpoint (0, 0, 0), so the
+// height limits keep their meaning. The hull polygon is rasterized on a grid
+// in the plane, segment() only runs the exact point in polygon test for
+// points in cells on the polygon boundary. All buffers are kept between
+// frames, an unchanged hull keeps its raster.
+class PlaneHull {
+public:
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    PlaneHull();
+
+    void setCellSize(float cell_size);
+
+    // Convex hull of cloud, or of indices when not null, projected to the
+    // plane given by coefficients, the vertices are points of cloud in
+    // counter-clockwise order
+    void computeHull(const CloudT &cloud, const std::vector<int> *indices, const pcl::ModelCoefficients &coefficients,
+                     CloudT &hull);
+
+    // Base of the prism, returns false for less than 3 hull points
+    bool setHull(const CloudT &hull);
+
+    void setHeightLimits(float height_min, float height_max);
+
+    // Indices of the points of cloud, or of indices when not null, that lie
+    // inside the prism
+    void segment(const CloudT &cloud, const std::vector<int> *indices, std::vector<int> &inside);
+
+private:
+    enum CellState {
+        CELL_OUTSIDE,
+        CELL_INSIDE,
+        CELL_BOUNDARY
+    };
+
+    static void planeBasis(const Eigen::Vector3f &normal, Eigen::Vector3f &u, Eigen::Vector3f &v);
+
+    bool insidePolygon(float a, float b) const;
+
+    void rasterize();
+
+    float cell_size_, height_min_, height_max_;
+
+    // Prism plane n.p + d = 0 and the basis u, v of its coordinates a, b
+    Eigen::Vector3f normal_, u_, v_;
+    float d_;
+
+    // Counter-clockwise hull polygon in plane coordinates
+    std::vector<Eigen::Vector2f> polygon_;
+
+    // Cells grow for large hulls to bound the raster size
+    float raster_cell_size_, min_a_, min_b_;
+    int cols_, rows_;
+    std::vector<uint8_t> cells_;
+
+    CloudT hull_;
+
+    // Monotone chain buffers
+    std::vector<Eigen::Vector2f> projected_;
+    std::vector<int> order_, chain_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_PLANE_HULL_H
@@ -0,0 +1,79 @@
+#ifndef POINT_CLOUD_PROC_PLANE_RANSAC_H
+#define POINT_CLOUD_PROC_PLANE_RANSAC_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Plane RANSAC that scores hypotheses on all cores. Hypotheses are drawn from
+// a seeded generator in fixed size batches, each batch is scored in parallel
+// and the best model is picked in hypothesis order, so the result only
+// depends on the seed and not on the number of threads. Sampling stops once
+// the usual bound log(1 - p) / log(1 - w^3) on the number of iterations for
+// the best inlier ratio w so far is reached. The best model is refined with a
+// least squares fit on its inliers like SACSegmentation with optimized
+// coefficients.
+class ParallelPlaneRansac {
+public:
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    ParallelPlaneRansac();
+
+    void setInputCloud(const CloudT::ConstPtr &cloud);
+
+    // Points to use, all points of the cloud when not set or empty
+    void setIndices(const pcl::PointIndices::ConstPtr &indices);
+
+    void setDistanceThreshold(float threshold);
+
+    void setMaxIterations(int max_iterations);
+
+    // Desired probability of drawing at least one outlier free sample
+    void setProbability(double probability);
+
+    // Only accepts planes with a normal within eps_angle (radians) of axis,
+    // like SACMODEL_PERPENDICULAR_PLANE. A zero axis accepts every plane.
+    void setAxis(const Eigen::Vector3f &axis, float eps_angle);
+
+    void setSeed(unsigned int seed);
+
+    void setNumberOfThreads(int threads);
+
+    // Number of hypotheses scored by the last segment() call
+    int getIterations() const;
+
+    bool segment(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients);
+
+private:
+    static const int BATCH_SIZE = 64;
+
+    bool isDegenerate(const Eigen::Vector4f &model) const;
+
+    size_t countInliers(const Eigen::Vector4f &model) const;
+
+    void selectInliers(const Eigen::Vector4f &model, std::vector<int> &inliers) const;
+
+    CloudT::ConstPtr cloud_;
+    pcl::PointIndices::ConstPtr indices_;
+    float threshold_;
+    int max_iterations_, threads_, iterations_;
+    double probability_;
+    Eigen::Vector3f axis_;
+    float eps_angle_;
+    unsigned int seed_;
+
+    // Points in use as separate coordinate arrays, reused between calls
+    std::vector<float> x_, y_, z_;
+    std::vector<int> point_indices_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_PLANE_RANSAC_H
@@ -0,0 +1,98 @@
+#ifndef POINT_CLOUD_PROC_PLANE_TRACKER_H
+#define POINT_CLOUD_PROC_PLANE_TRACKER_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Keeps the last accepted plane and its hull between frames. For a static
+// scene the plane found by RANSAC in an earlier frame is checked against
+// the new frame with one pass over the points: when it still has at least
+// min_inlier_ratio of the inliers RANSAC accepted and the refitted plane
+// still satisfies the axis constraint it is used as is, otherwise the caller
+// falls back to RANSAC and stores the new plane with update(). The hull is
+// kept as long as the inliers span the same extent within the hull
+// tolerance, a hull computed for a tracked plane is stored with
+// updateHull().
+//
+// The tracker is not synchronized. Callers sharing one can track() on a
+// copy taken under their lock and hand the refitted plane back with
+// accept(), so the scan over the cloud does not hold the lock.
+class PlaneTracker {
+public:
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    PlaneTracker();
+
+    void setDistanceThreshold(float threshold);
+
+    void setMinInlierRatio(float ratio);
+
+    void setHullTolerance(float tolerance);
+
+    // Largest angle in radians between the plane normal and a non zero axis,
+    // like the eps_angle of RANSAC
+    void setEpsAngle(float eps_angle);
+
+    // Forgets the tracked plane, the next track() fails
+    void reset();
+
+    bool hasPlane() const;
+
+    // Checks the tracked plane on cloud. On success inliers are the points
+    // within the distance threshold and coefficients the plane refitted to
+    // them. Fails when nothing is tracked or it was found for another axis.
+    bool track(const CloudT &cloud, const Eigen::Vector3f &axis,
+               pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients);
+
+    // True when the inliers of the last successful track() still fit the
+    // stored hull
+    bool hullValid() const;
+
+    const CloudT &getHull() const;
+
+    // Takes the refitted plane of a successful track() on a copy of this
+    // tracker, and its hull when updateHull() ran on the copy. Ignored when
+    // update() or reset() ran since the copy was made.
+    void accept(const PlaneTracker &tracked);
+
+    // Stores a plane found on cloud with its inliers and hull
+    void update(const CloudT &cloud, const std::vector<int> &inliers, const pcl::ModelCoefficients &coefficients,
+                const Eigen::Vector3f &axis, const CloudT &hull);
+
+    // Stores the hull of the inliers of a successful track(). The inlier
+    // count stays the one of the last RANSAC plane.
+    void updateHull(const CloudT &cloud, const std::vector<int> &inliers, const CloudT &hull);
+
+private:
+    void setHull(const CloudT &cloud, const std::vector<int> &inliers, const CloudT &hull);
+
+    float threshold_, min_inlier_ratio_, hull_tolerance_, eps_angle_;
+
+    // hull_updated_ tells accept() that updateHull() ran after track()
+    bool has_plane_, hull_valid_, hull_updated_;
+    Eigen::Vector4f model_;
+    Eigen::Vector3f axis_;
+    // Inliers of the last RANSAC plane stored by update(), tracked frames
+    // are compared against it so a drifting plane can not lose a share of
+    // them every frame
+    size_t num_inliers_;
+    // Bumped by update() and reset(), tells accept() whether a copy still
+    // tracks the same plane
+    unsigned int generation_;
+
+    // Extent of the inliers the hull was computed from
+    Eigen::Vector3f hull_min_, hull_max_;
+    CloudT hull_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_PLANE_TRACKER_H
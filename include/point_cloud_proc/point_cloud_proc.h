@@ -9,6 +9,8 @@
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/image_encodings.h>
 #include <std_srvs/Empty.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_listener.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <geometry_msgs/TransformStamped.h>
@@ -25,6 +27,13 @@
 #include <point_cloud_proc/MultiPlaneSegmentation.h>
 #include <point_cloud_proc/TabletopExtraction.h>
 #include <point_cloud_proc/TabletopClustering.h>
+#include <point_cloud_proc/cloud_view.h>
+#include <point_cloud_proc/plane_tracker.h>
+#include <point_cloud_proc/point_kernels.h>
+#include <point_cloud_proc/scene_segmenter.h>
+#include <point_cloud_proc/scratch_arena.h>
+#include <point_cloud_proc/spsc_queue.h>
+#include <point_cloud_proc/stage_stats.h>
 
 // PCL
 #include <pcl_ros/point_cloud.h>
@@ -33,7 +42,9 @@
 #include <pcl/point_types.h>
 #include <pcl/io/pcd_io.h>
 #include <pcl/common/common.h>
+#include <pcl/common/io.h>
 #include <pcl/common/pca.h>
+#include <pcl/common/transforms.h>
 #include <pcl/kdtree/kdtree.h>
 #include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/filters/passthrough.h>
@@ -61,11 +72,16 @@
 
 // Other
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/thread.hpp>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 #include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <limits>
 
 enum AXIS {
     XAXIS,
@@ -73,6 +89,92 @@ enum AXIS {
     ZAXIS
 };
 
+struct FrameStats {
+    uint64_t received = 0;
+    uint64_t consumed = 0;
+    uint64_t dropped = 0;
+    // Frames a stage of the streaming pipeline dropped for a newer one
+    uint64_t pipeline_dropped = 0;
+    // Frames and scratch buffers that had to be allocated or grow, stays
+    // the same in the steady state
+    uint64_t scratch_allocations = 0;
+};
+
+// Clouds and results of one frame on its way through the pipeline stages.
+// Every synchronous call and every frame of the streaming pipeline gets its
+// own, so they can be processed at the same time.
+struct FrameContext {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef pcl::PointCloud<pcl::PointXYZRGB> CloudT;
+    typedef boost::shared_ptr<FrameContext> Ptr;
+
+    FrameContext() :
+            transform(Eigen::Affine3f::Identity()), cloud_sensor(new CloudT), cloud_transformed(new CloudT),
+            cloud_filtered(new CloudT), cloud_hull(new CloudT), tabletop_indices(new pcl::PointIndices) {}
+
+    // Empties the frame for the next one, keeping the capacity of its
+    // clouds. Clouds still shared with another frame are replaced, returns
+    // how many.
+    size_t recycle() {
+        size_t allocated = point_cloud_proc::recycle(cloud_sensor) + point_cloud_proc::recycle(cloud_transformed) +
+                           point_cloud_proc::recycle(cloud_filtered) + point_cloud_proc::recycle(cloud_hull) +
+                           point_cloud_proc::recycle(tabletop_indices);
+        cloud_raw.reset();
+        transform = Eigen::Affine3f::Identity();
+        start = ros::WallTime();
+        object_pixel_indices.clear();
+        inside_limits.clear();
+        filtered = plane_found = objects_found = drop_spot_found = false;
+        plane = point_cloud_proc::Plane();
+        objects.clear();
+        drop_spot = geometry_msgs::Point();
+        return allocated;
+    }
+
+    // Message the clouds were made from and its transform to the fixed frame
+    sensor_msgs::PointCloud2ConstPtr cloud_raw;
+    Eigen::Affine3f transform;
+    ros::WallTime start;
+
+    // cloud_sensor is the frame in the sensor frame, cloud_transformed the
+    // same frame in the fixed frame with the same point order. The tabletop
+    // is a view of cloud_filtered through tabletop_indices.
+    CloudT::Ptr cloud_sensor, cloud_transformed, cloud_filtered, cloud_hull;
+    pcl::PointIndices::Ptr tabletop_indices;
+    std::vector<pcl::PointIndices> object_pixel_indices;
+    // Whether each point of cloud_transformed is inside the pass limits,
+    // tested along with the transform
+    std::vector<uint8_t> inside_limits;
+
+    bool filtered = false;
+    bool plane_found = false;
+    bool objects_found = false;
+    bool drop_spot_found = false;
+    point_cloud_proc::Plane plane;
+    std::vector<point_cloud_proc::Object> objects;
+    geometry_msgs::Point drop_spot;
+};
+
+// Result of one frame of the streaming pipeline. Published snapshots are
+// shared between callers and never modified again.
+struct PipelineSnapshot {
+    typedef boost::shared_ptr<const PipelineSnapshot> ConstPtr;
+
+    uint64_t seq = 0;
+    ros::Time stamp;
+    ros::WallDuration latency;
+    bool plane_found = false;
+    bool objects_found = false;
+    bool drop_spot_found = false;
+    point_cloud_proc::Plane plane;
+    std::vector<point_cloud_proc::Object> objects;
+    geometry_msgs::Point drop_spot;
+};
+
+// ROS front of the pipeline: subscription, TF, frames, streaming and the
+// messages and services. The algorithms run in the SceneSegmenter of the
+// point_cloud_proc_core library, which has no ROS dependency.
 class PointCloudProc {
     typedef pcl::PointXYZRGB PointT;
     typedef pcl::Normal PointNT;
@@ -80,16 +182,45 @@ class PointCloudProc {
 
 
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     typedef pcl::PointCloud<PointT> CloudT;
 
     PointCloudProc(ros::NodeHandle n, bool debug = false, std::string config = "");
 
+    // Offline instance without a ROS master: no subscriber, TF listener or
+    // debug publishers. Frames are handed in through pointCloudCb() and
+    // their transforms through setTransform(), every call takes the last
+    // frame handed in instead of waiting for a new one. Streaming is not
+    // available.
+    explicit PointCloudProc(std::string config,
+                            const ros::Duration &tf_cache_time = ros::Duration(tf2::BufferCore::DEFAULT_CACHE_TIME));
+
+    ~PointCloudProc();
+
     void pointCloudCb(const sensor_msgs::PointCloud2ConstPtr &msg);
 
+    // Adds a transform to the TF buffer, for offline instances that have no
+    // TF listener
+    void setTransform(const geometry_msgs::TransformStamped &transform, bool is_static = false);
+
+    // Blocks until a cloud stamped after newer_than arrives. A zero timeout
+    // waits until ROS shuts down.
+    bool waitForCloud(const ros::Time &newer_than, const ros::Duration &timeout = ros::Duration(0));
+
+    // All calls are safe to make from several threads at once, every call
+    // works on its own frame with filters leased from a pool. The step by
+    // step calls below and the getters of the last clouds see the frame of
+    // the last call that finished.
     bool transformPointCloud();
 
     bool filterPointCloud();
 
+    // transformPointCloud() followed by filterPointCloud(), or the single
+    // pass FusedFilter when fused_front_end is set. Only the filtered cloud
+    // is valid afterwards in fused mode.
+    bool transformAndFilterPointCloud();
+
     bool removeOutliers(CloudT::Ptr in, CloudT::Ptr out);
 
     bool segmentSinglePlane(point_cloud_proc::Plane &plane, char axis = 'z');
@@ -98,6 +229,10 @@ public:
 
     bool extractTabletop();
 
+    // Whole frame from transform to tabletop extraction, cloud is the
+    // tabletop in the fixed frame
+    bool extractTabletop(sensor_msgs::PointCloud2 &cloud);
+
     bool clusterObjects(std::vector<point_cloud_proc::Object> &objects,
             bool compute_normals = false,
             bool project = false);
@@ -128,6 +263,11 @@ public:
 
     pcl::PointIndices::Ptr getTabletopIndicies();
 
+    // Pixel masks (row * width + col) of the objects found by the last
+    // clusterObjects() call with ec_method organized, in the order of the
+    // objects. Empty for the other clustering methods.
+    void getObjectPixelIndices(std::vector<pcl::PointIndices> &indices);
+
     bool removePlane(CloudT &segmented_point_cloud, char axis = 'z');
 
     bool filterPointCloudWithLimits(std::vector<float> set_limits, const CloudT::Ptr input_cloud, CloudT::Ptr output_cloud);
@@ -138,40 +278,300 @@ public:
 
     CloudT::Ptr getCloud();
 
+    ros::WallDuration getTransformLatency() const;
+
+    FrameStats getFrameStats();
+
+    // Time and point counts in and out of every pipeline step since the
+    // last reset. Only counted while instrumentation is on, set in the
+    // config or turned on by a diagnostics_period above 0.
+    point_cloud_proc::PipelineStats getPipelineStats() const;
+
+    void resetPipelineStats();
+
+    void setInstrumentation(bool enabled);
+
     void getDefaultDropSpot(ros::Publisher drop_spot_pub);
 
+    // Stages of the pipeline on frame. acquireFrame() takes the next frame
+    // like the synchronous calls do, the stages return false when the frame
+    // gets stuck. segmentStage() fills plane, clusterStage() extracts the
+    // tabletop and fills objects.
+    bool acquireFrame(FrameContext &frame);
+
+    bool transformStage(FrameContext &frame);
+
+    bool filterStage(FrameContext &frame);
+
+    bool segmentStage(FrameContext &frame, char axis = 'z');
+
+    bool clusterStage(FrameContext &frame, bool compute_normals = false);
+
+    // Streaming mode: every stage runs on its own thread, connected by queues
+    // of pipeline_queue_size frames that drop their oldest frame when the
+    // next stage is behind. The last stage publishes a snapshot of the
+    // single plane, tabletop and clustering results of every frame.
+    // segmentSinglePlane() for the z axis, clusterObjects() and findDropSpot()
+    // (with streaming_drop_spot) then return the newest snapshot instead of
+    // waiting for a frame. Other calls run next to the stages.
+    bool startStreaming();
+
+    void stopStreaming();
+
+    bool isStreaming() const;
+
+    // Newest snapshot, null before the first frame was processed
+    PipelineSnapshot::ConstPtr getLatestSnapshot();
+
+    // Blocks until a snapshot of a frame stamped after newer_than is
+    // published, null on timeout or when streaming stops. A zero timeout
+    // waits until ROS shuts down.
+    PipelineSnapshot::ConstPtr waitForSnapshot(const ros::Time &newer_than,
+                                               const ros::Duration &timeout = ros::Duration(0));
+
   
     // bool findDropSpotScaled(ros::Publisher drop_spot_pub);
 
 
 private:
-    pcl::PassThrough<PointT> pass_;
-    pcl::VoxelGrid<PointT> vg_;
-    pcl::SACSegmentation<PointT> seg_;
-    pcl::ExtractIndices<PointT> extract_;
-    pcl::ConvexHull<PointT> chull_;
-    pcl::ExtractPolygonalPrismData<PointT> prism_;
-    pcl::EuclideanClusterExtraction<PointT> ec_;
-    pcl::RadiusOutlierRemoval<PointT> outrem_;
-    pcl::StatisticalOutlierRemoval<PointT> sor_;
-    pcl::ProjectInliers<PointT> plane_proj_;
-    pcl::GreedyProjectionTriangulation<pcl::PointNormal> gp3_;
-
-    bool debug_;
-    bool pc_received_ = false;
-    int k_search_, min_plane_size_, max_iter_, min_cluster_size_, max_cluster_size_, min_neighbors_;
-    float cluster_tol_, leaf_size_, eps_angle_, single_dist_thresh_, multi_dist_thresh_, radius_search_;
-
-    std::vector<float> pass_limits_, prism_limits_;
+    // Per thread buffers of clusterObjects(), kept between calls
+    struct ClusterScratch {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        ClusterScratch() : cluster(new CloudT), normals(new CloudNT) {}
+
+        CloudT::Ptr cluster;
+        CloudNT::Ptr normals;
+    };
+
+    // Filters and buffers of one call or pipeline stage. Workspaces are
+    // leased from a pool for the duration of a call and kept between calls,
+    // so concurrent calls never share one and buffers stay allocated.
+    struct Workspace {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        typedef boost::shared_ptr<Workspace> Ptr;
+
+        Workspace(const point_cloud_proc::SegmenterParams &params, point_cloud_proc::StageStats *stats) :
+                segmenter(params, stats) {}
+
+        point_cloud_proc::SceneSegmenter segmenter;
+        // Intermediate clouds of the call, taken back when the lease ends
+        point_cloud_proc::ScratchArena arena;
+        pcl::ExtractIndices<PointT> extract;
+        point_cloud_proc::NormalEngine<pcl::PointXYZ> mesh_normal_engine;
+        pcl::RadiusOutlierRemoval<PointT> outrem;
+        pcl::ProjectInliers<PointT> plane_proj;
+        pcl::GreedyProjectionTriangulation<pcl::PointNormal> gp3;
+        std::vector<boost::shared_ptr<ClusterScratch> > cluster_scratch;
+    };
+
+    // Takes a workspace from the pool, or makes a new one when all are in
+    // use, and hands it back when it goes out of scope
+    struct WorkspaceLease {
+        explicit WorkspaceLease(PointCloudProc &pcp);
+
+        ~WorkspaceLease();
+
+        WorkspaceLease(const WorkspaceLease &) = delete;
+
+        WorkspaceLease &operator=(const WorkspaceLease &) = delete;
+
+        Workspace &operator*() const { return *workspace; }
+
+        Workspace *operator->() const { return workspace.get(); }
+
+        PointCloudProc &pcp;
+        Workspace::Ptr workspace;
+    };
+
+    enum PipelineStage {
+        STAGE_TRANSFORM,
+        STAGE_FILTER,
+        STAGE_SEGMENT,
+        STAGE_CLUSTER,
+        NUM_STAGES
+    };
+
+    typedef point_cloud_proc::SpscQueue<FrameContext::Ptr> FrameQueue;
+
+    // Reads the parameters of config, default.yaml of the package when empty
+    YAML::Node loadConfig(const std::string &config);
+
+    void configureWorkspace(Workspace &ws) const;
+
+    // Returns false on timeout, shutdown or while stopStreaming() runs
+    bool waitForCloud(boost::mutex::scoped_lock &lock, uint64_t after_seq,
+                      const ros::Time &newer_than, const ros::Duration &timeout);
+
+    // Hands the current frame of pointCloudCb to frame and marks it
+    // consumed, lock holds pc_mutex_ and is released
+    void takeFrame(boost::mutex::scoped_lock &lock, FrameContext &frame);
+
+    // Empty frame from the pool, a pooled frame is reused once nothing but
+    // the pool references it
+    FrameContext::Ptr newFrame();
+
+    // Frame from the pool sharing the clouds and results of the last frame,
+    // the caller recycles the buffers it writes to so the allocations are
+    // counted
+    FrameContext::Ptr copyLastFrame();
+
+    // Frame of the last finished call, published frames are never modified
+    // again
+    FrameContext::Ptr lastFrame();
+
+    void setLastFrame(const FrameContext::Ptr &frame);
+
+    // Publishes the pipeline stats on the diagnostics topic
+    void publishDiagnostics(const ros::WallTimerEvent &event);
+
+    // Takes the next frame into frame and transforms it, with or without
+    // filtering
+    bool transformFrame(FrameContext &frame);
+
+    bool transformAndFilterFrame(FrameContext &frame, Workspace &ws);
+
+    // Work of filterStage() with the fused front end or filterTransformedCloud()
+    bool filterFrame(FrameContext &frame, Workspace &ws);
+
+    bool filterTransformedCloud(FrameContext &frame, Workspace &ws);
+
+    bool segmentPlane(FrameContext &frame, char axis, Workspace &ws);
+
+    bool segmentPlanes(FrameContext &frame, std::vector<point_cloud_proc::Plane> &planes, Workspace &ws);
+
+    bool extractTabletop(FrameContext &frame, Workspace &ws);
+
+    // Clusters the tabletop of the last extractTabletop() into objects
+    bool clusterTabletop(FrameContext &frame, std::vector<point_cloud_proc::Object> &objects,
+                         bool compute_normals, Workspace &ws);
+
+    bool removeOutliers(const CloudT::Ptr &in, const CloudT::Ptr &out, Workspace &ws);
+
+    bool filterWithLimits(const std::vector<float> &set_limits, const CloudT::Ptr &input_cloud,
+                          const CloudT::Ptr &output_cloud, Workspace &ws);
+
+    bool computeDropSpot(const CloudT::Ptr &cloud, geometry_msgs::Point &drop_off, Workspace &ws);
+
+    // Waits for new frames and transforms them, the first stage
+    void sourceLoop();
+
+    // Runs stage on the frames of input and hands them to output, the last
+    // stage publishes them
+    void stageLoop(PipelineStage stage, FrameQueue *input, FrameQueue *output);
+
+    void runStage(PipelineStage stage, FrameContext &frame);
+
+    void publishSnapshot(FrameContext &frame);
+
+    // Latest snapshot, waits up to frame_timeout_ for the first one
+    PipelineSnapshot::ConstPtr currentSnapshot();
+
+
+    // Fills plane from the inliers of cloud, their points are only copied
+    // into the message
+    std::string fillPlaneMsg(const CloudT::Ptr &cloud,
+                             const std::vector<int> &inliers,
+                             const pcl::ModelCoefficients &coefficients,
+                             point_cloud_proc::Plane &plane,
+                             Workspace &ws);
+
+    // Fills object from the points in indices of cloud, safe to call from
+    // several threads with their own scratch. Normals are sliced from the
+    // ones of cloud when given.
+    void computeObject(const CloudT &cloud, const pcl::PointIndices &indices, const CloudNT::ConstPtr &normals,
+                       const point_cloud_proc::SceneSegmenter &segmenter, ClusterScratch &scratch,
+                       point_cloud_proc::Object &object) const;
+
+    // Makes cloud_sensor and cloud_transformed of frame if the fused front
+    // end skipped them
+    bool ensureTransformedCloud(FrameContext &frame);
+
+    bool segmentOrganizedPlanes(FrameContext &frame, std::vector<point_cloud_proc::Plane> &planes, Workspace &ws);
+
+    bool lookupCloudTransform(const std_msgs::Header &header, Eigen::Affine3f &transform);
+
+    // Idle workspaces, the last one handed back is leased first
+    std::vector<Workspace::Ptr> workspaces_;
+    boost::mutex workspace_mutex_;
+
+    // The tracked plane is shared by all calls, track() and update() run
+    // under tracker_mutex_
+    point_cloud_proc::PlaneTracker plane_tracker_;
+    boost::mutex tracker_mutex_;
+
+    // Tabletop normals of all workspaces, so a frame computed again from
+    // the same message reuses them. compute() runs under normal_mutex_.
+    point_cloud_proc::NormalEngine<PointT> normal_engine_;
+    boost::mutex normal_mutex_;
+
+    // Parameters of the workspace segmenters, the ones below are only used
+    // by the adapter
+    point_cloud_proc::SegmenterParams params_;
+
+    bool debug_, offline_;
+    bool fused_front_end_, organized_planes_, plane_tracking_;
+    int min_neighbors_, cluster_threads_;
+    float single_dist_thresh_, multi_dist_thresh_, radius_search_;
+
     std::string point_cloud_topic_, fixed_frame_;
 
-    CloudT::Ptr cloud_transformed_, cloud_filtered_, cloud_hull_, cloud_tabletop_;
-    pcl::PointIndices::Ptr tabletop_indicies_;
-    sensor_msgs::PointCloud2 cloud_raw_ros_;
+    // Frame of the last finished synchronous call, swapped under frame_mutex_
+    FrameContext::Ptr last_frame_;
+    boost::mutex frame_mutex_;
 
-    boost::mutex pc_mutex_;
+    // Every frame ever made, for newFrame(). scratch_allocations_ counts the
+    // frames and workspace buffers that had to be allocated.
+    std::vector<FrameContext::Ptr> frame_pool_;
+    boost::mutex frame_pool_mutex_;
+    std::atomic<uint64_t> scratch_allocations_{0};
 
-    ros::NodeHandle nh_;
+    sensor_msgs::PointCloud2ConstPtr cloud_raw_ros_;
+
+    // Frames are handed over from pointCloudCb under pc_mutex_ as shared
+    // pointers and only converted when a call consumes them. frame_seq_
+    // counts received frames. A frame younger than frame_max_age_ is reused
+    // instead of waiting for the next one.
+    boost::mutex pc_mutex_;
+    boost::condition_variable pc_cond_;
+    uint64_t frame_seq_ = 0, consumed_seq_ = 0;
+    FrameStats frame_stats_;
+    ros::Duration frame_max_age_, frame_timeout_;
+
+    // Every stage thread leases its workspaces like a synchronous call.
+    // streaming_stop_ is guarded by pc_mutex_, snapshots are swapped under
+    // snapshot_mutex_.
+    std::atomic<bool> streaming_{false};
+    bool streaming_stop_ = false;
+    bool streaming_normals_, streaming_drop_spot_;
+    int pipeline_queue_size_;
+    boost::thread_group streaming_threads_;
+    FrameQueue filter_queue_, segment_queue_, cluster_queue_;
+    boost::mutex snapshot_mutex_;
+    boost::condition_variable snapshot_cond_;
+    PipelineSnapshot::ConstPtr latest_snapshot_;
+    uint64_t snapshot_seq_ = 0;
+
+    // TF is kept alive for the lifetime of the object so the buffer is already
+    // filled when a request comes in. The last transform is cached by source
+    // frame and stamp, the target is always fixed_frame_. The cache and the
+    // latency are guarded by tf_mutex_, lookups run without it.
+    tf2_ros::Buffer tf_buffer_;
+    boost::scoped_ptr<tf2_ros::TransformListener> tf_listener_;
+    geometry_msgs::TransformStamped cached_transform_;
+    std::string cached_source_frame_;
+    double tf_timeout_;
+    ros::WallDuration transform_latency_;
+    mutable boost::mutex tf_mutex_;
+
+    // Updated from const methods and the clustering threads
+    mutable point_cloud_proc::StageStats stage_stats_;
+    ros::WallTimer diagnostics_timer_;
+    ros::Publisher diagnostics_pub_;
+
+    // Offline instances have no node handle, creating one needs ros::init()
+    boost::scoped_ptr<ros::NodeHandle> nh_;
     ros::Subscriber point_cloud_sub_;
     ros::Publisher plane_cloud_pub_, tabletop_pub_, debug_cloud_pub_;
     ros::Publisher object_poses_pub_;
@@ -0,0 +1,34 @@
+#ifndef POINT_CLOUD_PROC_POINT_KERNELS_H
+#define POINT_CLOUD_PROC_POINT_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace point_cloud_proc {
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE4,
+    SIMD_AVX2
+};
+
+// Instruction set picked at runtime for the kernels below
+SimdLevel simdLevel();
+
+const char *simdLevelName(SimdLevel level);
+
+// Transforms n points stored as separate x, y, z arrays in place with the
+// row-major 3x4 matrix m, then tests them against box = {x_min, x_max, y_min,
+// y_max, z_min, z_max} with inclusive bounds. keep[i] is 1 for points inside
+// the box and 0 otherwise, NaN points are never kept. Returns the number of
+// kept points.
+size_t transformCropPoints(float *x, float *y, float *z, size_t n,
+                           const float *m, const float *box, uint8_t *keep);
+
+// Same as above with a fixed instruction set, used for testing and benchmarks
+size_t transformCropPoints(SimdLevel level, float *x, float *y, float *z, size_t n,
+                           const float *m, const float *box, uint8_t *keep);
+
+}
+
+#endif //POINT_CLOUD_PROC_POINT_KERNELS_H
@@ -0,0 +1,203 @@
+#ifndef POINT_CLOUD_PROC_SCENE_SEGMENTER_H
+#define POINT_CLOUD_PROC_SCENE_SEGMENTER_H
+
+#include <point_cloud_proc/diameter.h>
+#include <point_cloud_proc/fused_filter.h>
+#include <point_cloud_proc/grid_clustering.h>
+#include <point_cloud_proc/normal_engine.h>
+#include <point_cloud_proc/organized_clustering.h>
+#include <point_cloud_proc/plane_hull.h>
+#include <point_cloud_proc/plane_ransac.h>
+#include <point_cloud_proc/stage_stats.h>
+#include <point_cloud_proc/voxel_hash_grid.h>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/segmentation/sac_segmentation.h>
+#include <pcl/segmentation/extract_clusters.h>
+#include <pcl/segmentation/extract_polygonal_prism_data.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/surface/convex_hull.h>
+#include <Eigen/Geometry>
+
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Parameters of SceneSegmenter, the names follow the config file
+struct SegmenterParams {
+    SegmenterParams();
+
+    // Filters, limits are x_min, x_max, y_min, y_max, z_min, z_max and the
+    // prism heights min, max above the plane
+    std::vector<float> pass_limits, prism_limits;
+    float leaf_size;
+    bool hash_voxel_grid;
+    VoxelMode voxel_mode;
+    bool monotone_hull;
+
+    // Planes, eps_angle in degrees
+    float eps_angle;
+    int max_iter, min_plane_size;
+    bool parallel_sac;
+    int sac_threads;
+    unsigned int sac_seed;
+    double sac_probability;
+    float ne_max_depth_change, ne_smoothing_size;
+
+    // Clusters and objects
+    ClusterMethod cluster_method;
+    float cluster_tol;
+    int min_cluster_size, max_cluster_size;
+    // Size limits of clusterOrganized(), in pixels of the full resolution
+    // cloud instead of voxels
+    int organized_min_cluster_size, organized_max_cluster_size;
+    int k_search, ne_threads;
+    DiameterMethod diameter_method;
+    float diameter_max_error;
+};
+
+// Shape of one object cluster
+struct ObjectGeometry {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    Eigen::Vector4f center, min, max;
+    // Ends of the diameter, the object y axis points from pmax to pmin
+    pcl::PointXYZRGB pmin, pmax;
+    Eigen::Quaterniond orientation;
+};
+
+// The algorithms of the pipeline on PCL clouds without ROS: front end
+// filters, plane fitting, hulls, prisms, clustering and object features. An
+// instance keeps its filters and buffers between calls and is not
+// thread-safe, use one per thread. computeObject() is the exception, it only
+// reads the instance. Every step is timed into stats when it is given.
+class SceneSegmenter {
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+    typedef pcl::PointCloud<pcl::Normal> CloudNT;
+
+    explicit SceneSegmenter(const SegmenterParams &params = SegmenterParams(), StageStats *stats = NULL);
+
+    const SegmenterParams &params() const { return params_; }
+
+    // Transform, crop and voxel grid in one pass over a raw point buffer,
+    // any message with the layout of sensor_msgs::PointCloud2 or
+    // pcl::PCLPointCloud2
+    template<typename CloudMsg>
+    bool fusedFilter(const CloudMsg &cloud_in, const Eigen::Affine3f &transform, CloudT &cloud_out) {
+        ScopedStageTimer timer(stats_, STATS_FUSED_FILTER, cloud_in.width * cloud_in.height);
+        configureFusedFilter(transform);
+        bool filtered = fused_filter_.filter(cloud_in, cloud_out);
+        timer.setPointsOut(cloud_out.points.size());
+        return filtered;
+    }
+
+    // Points of cloud_in inside pass_limits, returns false when none is left
+    bool crop(const CloudT &cloud_in, CloudT &cloud_out);
+
+    // Same with the crop test transformCropPointCloud() already made for
+    // every point of cloud_in
+    bool crop(const CloudT &cloud_in, const std::vector<uint8_t> &inside, CloudT &cloud_out);
+
+    // Indices of the points of cloud inside pass_limits, for organized
+    // clouds that have to keep their image grid
+    void cropIndices(const CloudT &cloud, pcl::PointIndices &inside) const;
+
+    // Voxel grid with pcl::VoxelGrid or VoxelHashGrid, cloud_out can be
+    // cloud_in
+    void downsample(const CloudT::Ptr &cloud_in, CloudT &cloud_out);
+
+    // Plane RANSAC on indices of cloud (all points when indices is null or
+    // empty) with pcl::SACSegmentation or ParallelPlaneRansac. A non zero
+    // axis only accepts planes perpendicular to it within eps_angle.
+    bool fitPlane(const CloudT::Ptr &cloud, const pcl::PointIndices::Ptr &indices, float dist_thresh,
+                  const Eigen::Vector3f &axis, pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients);
+
+    // Planes of cloud, largest first, until less than min_plane_size points
+    // are left or fit. remaining gets the indices of the points in no plane.
+    void fitPlanes(const CloudT::Ptr &cloud, float dist_thresh, std::vector<pcl::PointIndices> &inliers,
+                   std::vector<pcl::ModelCoefficients> &coefficients, pcl::PointIndices &remaining);
+
+    // Planes of an organized cloud on its image grid, cloud_transformed is
+    // the same cloud in the frame of pass_limits and transform maps cloud to
+    // it. The coefficients are in the frame of cloud_transformed.
+    bool fitOrganizedPlanes(const CloudT &cloud, const CloudT &cloud_transformed, const Eigen::Affine3f &transform,
+                            float dist_thresh, std::vector<pcl::PointIndices> &inliers,
+                            std::vector<pcl::ModelCoefficients> &coefficients);
+
+    // Planar hull of the plane points, indices of cloud or all points when
+    // indices is null, with pcl::ConvexHull or PlaneHull
+    void computeHull(const CloudT::Ptr &cloud, const std::vector<int> *indices,
+                     const pcl::ModelCoefficients &coefficients, CloudT &hull);
+
+    // Points of cloud, or of indices when not null, in the prism over hull
+    // within prism_limits
+    void segmentPrism(const CloudT::Ptr &cloud, const pcl::PointIndices::Ptr &indices, const CloudT::Ptr &hull,
+                      pcl::PointIndices &inside);
+
+    // Euclidean clusters of the points in indices of cloud, all points when
+    // indices is null, with the kdtree or grid method, largest first. The
+    // cluster indices are indices of cloud.
+    void cluster(const CloudT::Ptr &cloud, const pcl::PointIndices::ConstPtr &indices,
+                 std::vector<pcl::PointIndices> &clusters);
+
+    // Clusters of the pixels in indices on the image grid of an organized
+    // cloud
+    void clusterOrganized(const CloudT::Ptr &cloud, const std::vector<int> &indices,
+                          std::vector<pcl::PointIndices> &clusters);
+
+    // Normals of the points in indices of cloud, all points when indices is
+    // null, by engine with the neighbourhood of the parameters. Clouds of
+    // the same source reuse the normals, see NormalEngine.
+    CloudNT::ConstPtr computeNormals(NormalEngine<PointT> &engine, const CloudT::Ptr &cloud,
+                                     const pcl::PointIndices::Ptr &indices,
+                                     const NormalSource &source = NormalSource()) const;
+
+    // Copies the points in indices of cloud to cluster and fills geometry,
+    // safe to call from several threads with their own cluster
+    void computeObject(const CloudT &cloud, const pcl::PointIndices &indices, CloudT &cluster,
+                       ObjectGeometry &geometry) const;
+
+    // Drops the references the filters keep to the clouds of the last call,
+    // so their owners can reuse them. Search trees keep theirs until the
+    // next build.
+    void releaseInputs();
+
+private:
+    void configureFusedFilter(const Eigen::Affine3f &transform);
+
+    SegmenterParams params_;
+    StageStats *stats_;
+
+    pcl::VoxelGrid<PointT> vg_;
+    pcl::SACSegmentation<PointT> seg_;
+    pcl::ConvexHull<PointT> chull_;
+    pcl::ExtractPolygonalPrismData<PointT> prism_;
+    pcl::EuclideanClusterExtraction<PointT> ec_;
+    GridClustering grid_ec_;
+    ParallelPlaneRansac plane_ransac_;
+    PlaneHull plane_hull_, prism_hull_;
+    FusedFilter fused_filter_;
+    VoxelHashGrid voxel_grid_;
+
+    // Buffers of the steps, kept between calls so the steady state does not
+    // allocate
+    pcl::search::KdTree<PointT>::Ptr tree_;
+    pcl::PointIndices::Ptr remaining_;
+    pcl::IndicesPtr hull_indices_;
+    std::vector<uint8_t> is_inlier_;
+    CloudT::Ptr cloud_masked_;
+    CloudNT::Ptr organized_normals_;
+    pcl::PointCloud<pcl::Label>::Ptr labels_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_SCENE_SEGMENTER_H
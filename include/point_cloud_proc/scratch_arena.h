@@ -0,0 +1,71 @@
+#ifndef POINT_CLOUD_PROC_SCRATCH_ARENA_H
+#define POINT_CLOUD_PROC_SCRATCH_ARENA_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+namespace point_cloud_proc {
+
+// Empties a buffer for reuse with the capacity it had, when nothing else
+// holds it. A buffer that is still shared, or null, is replaced by a new
+// one. Returns true when it had to allocate.
+bool recycle(pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud);
+
+bool recycle(pcl::PointIndices::Ptr &indices);
+
+bool recycle(pcl::ModelCoefficients::Ptr &coefficients);
+
+// Intermediate clouds, indices and coefficients of one call, recycled
+// between calls. Buffers are handed out empty and keep the capacity they
+// grew to in earlier frames, so once every buffer has seen a frame of the
+// usual size the steady state does not allocate. reset() takes all of them
+// back, a buffer the caller kept a reference to is left to it and replaced
+// on its next use. Not thread-safe, one per thread.
+class ScratchArena {
+public:
+    typedef pcl::PointCloud<pcl::PointXYZRGB> CloudT;
+
+    ScratchArena();
+
+    CloudT::Ptr cloud();
+
+    pcl::PointIndices::Ptr indices();
+
+    pcl::ModelCoefficients::Ptr coefficients();
+
+    // Hands all buffers back for the next call
+    void reset();
+
+    // Buffers that were made or grew since the last call, counted when they
+    // are handed back
+    uint64_t takeAllocations();
+
+private:
+    template<typename T>
+    struct Slot {
+        boost::shared_ptr<T> buffer;
+        size_t capacity;
+    };
+
+    template<typename T>
+    boost::shared_ptr<T> lease(std::vector<Slot<T> > &slots, size_t &used);
+
+    template<typename T>
+    void release(std::vector<Slot<T> > &slots, size_t &used);
+
+    std::vector<Slot<CloudT> > clouds_;
+    std::vector<Slot<pcl::PointIndices> > indices_;
+    std::vector<Slot<pcl::ModelCoefficients> > coefficients_;
+    size_t clouds_used_, indices_used_, coefficients_used_;
+    uint64_t allocations_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_SCRATCH_ARENA_H
@@ -0,0 +1,87 @@
+#ifndef POINT_CLOUD_PROC_SPSC_QUEUE_H
+#define POINT_CLOUD_PROC_SPSC_QUEUE_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <deque>
+#include <stdint.h>
+
+namespace point_cloud_proc {
+
+// Bounded queue between two pipeline stages, one thread pushes and one pops.
+// A full queue drops its oldest item so the consumer always gets the newest
+// frames. close() wakes up the consumer and discards what is left.
+template<typename T>
+class SpscQueue {
+public:
+    SpscQueue() : capacity_(1), closed_(true), dropped_(0) {}
+
+    // Empties the queue and accepts items again
+    void open(size_t capacity) {
+        boost::mutex::scoped_lock lock(mutex_);
+        items_.clear();
+        capacity_ = capacity > 0 ? capacity : 1;
+        closed_ = false;
+    }
+
+    void close() {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            closed_ = true;
+            items_.clear();
+        }
+        cond_.notify_all();
+    }
+
+    // Returns false when the oldest item had to be dropped, items pushed to a
+    // closed queue are discarded
+    bool push(const T &item) {
+        bool dropped = false;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (closed_) {
+                return true;
+            }
+            if (items_.size() >= capacity_) {
+                items_.pop_front();
+                dropped_++;
+                dropped = true;
+            }
+            items_.push_back(item);
+        }
+        cond_.notify_one();
+        return !dropped;
+    }
+
+    // Blocks until an item is available, false once the queue is closed
+    bool pop(T &item) {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (items_.empty() && !closed_) {
+            cond_.wait(lock);
+        }
+        if (closed_) {
+            return false;
+        }
+        item = items_.front();
+        items_.pop_front();
+        return true;
+    }
+
+    uint64_t dropped() const {
+        boost::mutex::scoped_lock lock(mutex_);
+        return dropped_;
+    }
+
+private:
+    mutable boost::mutex mutex_;
+    boost::condition_variable cond_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_;
+    uint64_t dropped_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_SPSC_QUEUE_H
@@ -0,0 +1,116 @@
+#ifndef POINT_CLOUD_PROC_STAGE_STATS_H
+#define POINT_CLOUD_PROC_STAGE_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace point_cloud_proc {
+
+// Instrumented steps of the pipeline
+enum StatsStage {
+    STATS_TRANSFORM,        // TF lookup, message conversion and transform
+    STATS_CROP,             // pass-through limits on x, y and z
+    STATS_VOXEL,            // voxel grid
+    STATS_FUSED_FILTER,     // transform, crop and voxel grid in one pass
+    STATS_RANSAC,           // plane fit
+    STATS_HULL,             // plane hull
+    STATS_PRISM,            // points above the hull
+    STATS_CLUSTERING,       // euclidean clustering of the tabletop
+    STATS_NORMALS,          // normals of the clustered points
+    STATS_OBJECT_FEATURES,  // pose, bounds and cloud of every cluster
+    STATS_SERIALIZATION,    // PCL clouds to ROS messages
+    NUM_STATS_STAGES
+};
+
+const char *statsStageName(StatsStage stage);
+
+struct StageCounters {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t points_in = 0;
+    uint64_t points_out = 0;
+
+    double meanMs() const { return calls > 0 ? total_ns / 1e6 / calls : 0.0; }
+    double maxMs() const { return max_ns / 1e6; }
+};
+
+struct PipelineStats {
+    StageCounters stages[NUM_STATS_STAGES];
+};
+
+// Counters of every stage since the last reset, updated from any thread.
+// While disabled a ScopedStageTimer costs one relaxed load, no clock is read.
+class StageStats {
+public:
+    StageStats();
+
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void add(StatsStage stage, uint64_t ns, size_t points_in, size_t points_out);
+
+    void get(PipelineStats &stats) const;
+
+    void reset();
+
+private:
+    struct AtomicCounters {
+        std::atomic<uint64_t> calls, total_ns, max_ns, points_in, points_out;
+    };
+
+    std::atomic<bool> enabled_;
+    AtomicCounters counters_[NUM_STATS_STAGES];
+};
+
+// Times its scope and adds it to stats with the point counts set on it
+class ScopedStageTimer {
+public:
+    ScopedStageTimer(StageStats &stats, StatsStage stage, size_t points_in = 0) :
+            stats_(stats.enabled() ? &stats : NULL), stage_(stage), points_in_(points_in), points_out_(0) {
+        if (stats_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Times nothing when stats is null
+    ScopedStageTimer(StageStats *stats, StatsStage stage, size_t points_in = 0) :
+            stats_(stats && stats->enabled() ? stats : NULL), stage_(stage), points_in_(points_in), points_out_(0) {
+        if (stats_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedStageTimer() {
+        stop();
+    }
+
+    // Ends the timing before the end of the scope
+    void stop() {
+        if (stats_) {
+            stats_->add(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start_).count(), points_in_, points_out_);
+            stats_ = NULL;
+        }
+    }
+
+    void setPointsIn(size_t points) { points_in_ = points; }
+
+    void setPointsOut(size_t points) { points_out_ = points; }
+
+private:
+    ScopedStageTimer(const ScopedStageTimer &);
+    ScopedStageTimer &operator=(const ScopedStageTimer &);
+
+    StageStats *stats_;
+    StatsStage stage_;
+    size_t points_in_, points_out_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_STAGE_STATS_H
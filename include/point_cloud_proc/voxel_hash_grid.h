@@ -0,0 +1,82 @@
+#ifndef POINT_CLOUD_PROC_VOXEL_HASH_GRID_H
+#define POINT_CLOUD_PROC_VOXEL_HASH_GRID_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <string>
+#include <vector>
+
+namespace point_cloud_proc {
+
+enum VoxelMode {
+    VOXEL_CENTROID,         // mean position, color of the first point
+    VOXEL_FIRST_POINT,      // first point that fell into the voxel
+    VOXEL_COLOR_AVERAGE     // mean position and color, same as pcl::VoxelGrid
+};
+
+bool voxelModeFromString(const std::string &name, VoxelMode &mode);
+
+// Voxel downsampling in a single pass. Occupied voxels are kept in an open
+// addressing hash table keyed by the voxel coordinates, so memory only grows
+// with the number of occupied voxels and not with the extent of the cloud
+// like the index of pcl::VoxelGrid. The table and voxel storage are reused
+// between frames. Voxel cells are the same floor(p / leaf) cells VoxelGrid
+// uses, output points are in the order their voxels were first hit. Points
+// more than 2^20 leaves from the origin on any axis do not fit the key and
+// are dropped, dropped() counts them.
+class VoxelHashGrid {
+public:
+    typedef pcl::PointXYZRGB PointT;
+    typedef pcl::PointCloud<PointT> CloudT;
+
+    VoxelHashGrid();
+
+    void setLeafSize(float leaf_size);
+
+    void setMode(VoxelMode mode);
+
+    // Empties the grid, keeps the allocated memory
+    void clear();
+
+    // Returns false when the point is out of the key range and was dropped
+    bool addPoint(float x, float y, float z, uint32_t rgb);
+
+    size_t size() const;
+
+    // Points dropped since the last clear()
+    size_t dropped() const;
+
+    void getCloud(CloudT &cloud_out) const;
+
+    // clear(), addPoint() for all finite points and getCloud(). cloud_in and
+    // cloud_out can be the same cloud.
+    void filter(const CloudT &cloud_in, CloudT &cloud_out);
+
+private:
+    struct Voxel {
+        float x, y, z;
+        uint32_t r, g, b;
+        uint32_t rgb;
+        uint32_t count;
+        uint64_t key;
+        uint32_t slot;
+    };
+
+    static const uint32_t EMPTY_SLOT = 0xffffffff;
+
+    void rehash(size_t capacity);
+
+    float leaf_size_, inverse_leaf_size_;
+    VoxelMode mode_;
+
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> slots_;
+    size_t mask_;
+    std::vector<Voxel> voxels_;
+    size_t dropped_;
+};
+
+}
+
+#endif //POINT_CLOUD_PROC_VOXEL_HASH_GRID_H
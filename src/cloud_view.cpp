@@ -0,0 +1,98 @@
+#include <point_cloud_proc/cloud_view.h>
+#include <pcl/conversions.h>
+
+#include <cstring>
+#include <limits>
+
+namespace point_cloud_proc {
+
+bool computeBounds(const CloudView &view, Eigen::Vector3f &centroid, Eigen::Vector3f &min, Eigen::Vector3f &max) {
+
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    const size_t n = view.size();
+    for (size_t i = 0; i < n; i++) {
+        Eigen::Vector3f p = view[i].getVector3fMap();
+        sum += p;
+        min = min.cwiseMin(p);
+        max = max.cwiseMax(p);
+    }
+    if (n == 0) {
+        centroid = Eigen::Vector3f::Zero();
+        return false;
+    }
+    centroid = sum / static_cast<float>(n);
+    return true;
+}
+
+bool computeCovariance(const CloudView &view, Eigen::Vector3d &centroid, Eigen::Matrix3d &covariance) {
+
+    const size_t n = view.size();
+    centroid = Eigen::Vector3d::Zero();
+    covariance = Eigen::Matrix3d::Zero();
+    if (n == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        centroid += view[i].getVector3fMap().cast<double>();
+    }
+    centroid /= n;
+    // Around the centroid, the points are far from the origin
+    for (size_t i = 0; i < n; i++) {
+        Eigen::Vector3d diff = view[i].getVector3fMap().cast<double>() - centroid;
+        covariance += diff * diff.transpose();
+    }
+    covariance /= n;
+    return true;
+}
+
+void toPCLPointCloud2(const CloudView &view, pcl::PCLPointCloud2 &msg) {
+
+    typedef CloudView::PointT PointT;
+    msg.header = view.cloud->header;
+    msg.height = 1;
+    msg.width = view.size();
+    msg.fields.clear();
+    pcl::for_each_type<pcl::traits::fieldList<PointT>::type>(pcl::detail::FieldAdder<PointT>(msg.fields));
+    msg.is_bigendian = false;
+    msg.point_step = sizeof(PointT);
+    msg.row_step = msg.point_step * msg.width;
+    msg.is_dense = view.cloud->is_dense;
+
+    msg.data.resize(static_cast<size_t>(msg.row_step));
+    for (size_t i = 0; i < view.size(); i++) {
+        std::memcpy(&msg.data[i * sizeof(PointT)], &view[i], sizeof(PointT));
+    }
+}
+
+void keepIndices(pcl::PointCloud<pcl::PointXYZRGB> &cloud, const std::vector<int> &indices) {
+
+    // indices[i] >= i, every point is moved down before it is overwritten
+    for (size_t i = 0; i < indices.size(); i++) {
+        cloud.points[i] = cloud.points[indices[i]];
+    }
+    cloud.points.resize(indices.size());
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+void removeIndices(pcl::PointCloud<pcl::PointXYZRGB> &cloud, const std::vector<int> &indices) {
+
+    size_t kept = 0, next = 0;
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        bool removed = false;
+        while (next < indices.size() && indices[next] == static_cast<int>(i)) {
+            removed = true;
+            next++;
+        }
+        if (!removed) {
+            cloud.points[kept++] = cloud.points[i];
+        }
+    }
+    cloud.points.resize(kept);
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+}
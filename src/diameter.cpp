@@ -0,0 +1,198 @@
+#include <point_cloud_proc/diameter.h>
+#include <pcl/pcl_config.h>
+#include <pcl/common/common.h>
+#include <pcl/surface/convex_hull.h>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace point_cloud_proc {
+
+namespace {
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+
+inline float squaredDistance(const PointT &a, const PointT &b) {
+    float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// All pairs of the points in candidates
+float farthestPair(const CloudT &cloud, const std::vector<int> &candidates, int &first, int &second) {
+    float best = -1.0f;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const PointT &a = cloud.points[candidates[i]];
+        for (size_t j = i + 1; j < candidates.size(); j++) {
+            float distance = squaredDistance(a, cloud.points[candidates[j]]);
+            if (distance > best) {
+                best = distance;
+                first = candidates[i];
+                second = candidates[j];
+            }
+        }
+    }
+    return best;
+}
+
+#if !PCL_VERSION_COMPARE(>=, 1, 8, 0)
+// Index of the first point of cloud at the position of p, -1 if none
+int findPoint(const CloudT &cloud, const PointT &p) {
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        const PointT &q = cloud.points[i];
+        if (q.x == p.x && q.y == p.y && q.z == p.z) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+#endif
+
+// Directions on the upper hemisphere on latitude rings, spaced so every unit
+// vector or its negation is within max_angle of one of them: at most half
+// the spacing to the closest ring and half the spacing along it
+void sampleDirections(float max_angle, std::vector<Eigen::Vector3f> &directions) {
+    int rings = static_cast<int>(std::ceil(0.5 * M_PI / max_angle));
+    double ring_step = 0.5 * M_PI / rings;
+    for (int i = 0; i <= rings; i++) {
+        double latitude = i * ring_step;
+        int count = std::max(1, static_cast<int>(std::ceil(2.0 * M_PI * std::cos(latitude) / max_angle)));
+        // The equator only needs half a ring, the other half are negations
+        if (i == 0) {
+            count = std::max(1, (count + 1) / 2);
+        }
+        double span = i == 0 ? M_PI : 2.0 * M_PI;
+        for (int j = 0; j < count; j++) {
+            double longitude = span * j / count;
+            directions.push_back(Eigen::Vector3f(std::cos(latitude) * std::cos(longitude),
+                                                 std::cos(latitude) * std::sin(longitude),
+                                                 std::sin(latitude)));
+        }
+    }
+}
+
+float hullDiameter(const CloudT &cloud, int &first, int &second) {
+
+    CloudT::Ptr input(new CloudT(cloud));
+    CloudT hull;
+    std::vector<pcl::Vertices> polygons;
+    pcl::PointIndices hull_indices;
+    {
+        boost::mutex::scoped_lock lock(qhullMutex());
+        pcl::ConvexHull<PointT> chull;
+        chull.setInputCloud(input);
+        chull.reconstruct(hull, polygons);
+#if PCL_VERSION_COMPARE(>=, 1, 8, 0)
+        chull.getHullPointIndices(hull_indices);
+#endif
+    }
+
+#if !PCL_VERSION_COMPARE(>=, 1, 8, 0)
+    // PCL 1.7 has no getHullPointIndices(). The hull vertices are copies of
+    // points of cloud, the farthest pair of them is found back by position.
+    if (hull.points.size() >= 2) {
+        std::vector<int> vertices(hull.points.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            vertices[i] = static_cast<int>(i);
+        }
+        int hull_first = 0, hull_second = 0;
+        float best = farthestPair(hull, vertices, hull_first, hull_second);
+        first = findPoint(cloud, hull.points[hull_first]);
+        second = findPoint(cloud, hull.points[hull_second]);
+        if (first >= 0 && second >= 0) {
+            return best;
+        }
+    }
+#endif
+
+    // Degenerate clouds (fewer than 4 points, a line) go through all points
+    std::vector<int> candidates;
+    if (hull_indices.indices.size() >= 2) {
+        candidates = hull_indices.indices;
+    } else {
+        candidates.resize(cloud.points.size());
+        for (size_t i = 0; i < candidates.size(); i++) {
+            candidates[i] = static_cast<int>(i);
+        }
+    }
+    return farthestPair(cloud, candidates, first, second);
+}
+
+float approxDiameter(const CloudT &cloud, float max_error, int &first, int &second) {
+
+    max_error = std::min(std::max(max_error, 1e-4f), 0.5f);
+    std::vector<Eigen::Vector3f> directions;
+    sampleDirections(std::acos(1.0f - max_error), directions);
+
+    const size_t num_directions = directions.size();
+    std::vector<float> min_proj(num_directions, std::numeric_limits<float>::max());
+    std::vector<float> max_proj(num_directions, -std::numeric_limits<float>::max());
+    std::vector<int> min_index(num_directions, 0), max_index(num_directions, 0);
+
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        const PointT &p = cloud.points[i];
+        for (size_t d = 0; d < num_directions; d++) {
+            float proj = directions[d][0] * p.x + directions[d][1] * p.y + directions[d][2] * p.z;
+            if (proj < min_proj[d]) {
+                min_proj[d] = proj;
+                min_index[d] = static_cast<int>(i);
+            }
+            if (proj > max_proj[d]) {
+                max_proj[d] = proj;
+                max_index[d] = static_cast<int>(i);
+            }
+        }
+    }
+
+    // The extreme points along a direction within angle a of the diameter D
+    // are at least cos(a) * D apart, and cos(a) >= 1 - max_error. The
+    // farthest pair among all of them is therefore at least
+    // (1 - max_error) * D apart, a bound relative to D.
+    std::vector<int> candidates(min_index);
+    candidates.insert(candidates.end(), max_index.begin(), max_index.end());
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return farthestPair(cloud, candidates, first, second);
+}
+
+}
+
+bool diameterMethodFromString(const std::string &name, DiameterMethod &method) {
+    if (name == "pcl") {
+        method = DIAMETER_PCL;
+    } else if (name == "hull") {
+        method = DIAMETER_HULL;
+    } else if (name == "approx") {
+        method = DIAMETER_APPROX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+double computeDiameter(const CloudT &cloud, DiameterMethod method, PointT &pmin, PointT &pmax, float max_error) {
+
+    if (method == DIAMETER_PCL || cloud.points.size() < 2) {
+        return pcl::getMaxSegment(cloud, pmin, pmax);
+    }
+
+    int first = 0, second = 0;
+    float squared = method == DIAMETER_HULL ? hullDiameter(cloud, first, second)
+                                            : approxDiameter(cloud, max_error, first, second);
+    if (squared < 0.0f) {
+        return pcl::getMaxSegment(cloud, pmin, pmax);
+    }
+    pmin = cloud.points[first];
+    pmax = cloud.points[second];
+    return std::sqrt(squared);
+}
+
+boost::mutex &qhullMutex() {
+    static boost::mutex mutex;
+    return mutex;
+}
+
+}
@@ -0,0 +1,194 @@
+#include <point_cloud_proc/fused_filter.h>
+#include <point_cloud_proc/point_kernels.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace point_cloud_proc {
+
+namespace {
+
+inline float readFloat(const uint8_t *data) {
+    float value;
+    std::memcpy(&value, data, sizeof(float));
+    return value;
+}
+
+// The row-major 3x4 matrix transformCropPoints() expects
+void toRowMajor(const Eigen::Affine3f &transform, float *matrix) {
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 4; col++) {
+            matrix[row * 4 + col] = transform.matrix()(row, col);
+        }
+    }
+}
+
+const size_t CLOUD_BATCH_SIZE = 256;
+
+}
+
+FusedFilter::FusedFilter() :
+        limits_(6, 0.0f) {
+    setTransform(Eigen::Affine3f::Identity());
+}
+
+void FusedFilter::setTransform(const Eigen::Affine3f &transform) {
+    toRowMajor(transform, matrix_);
+}
+
+void FusedFilter::setLimits(const std::vector<float> &limits) {
+    limits_ = limits;
+}
+
+void FusedFilter::setLeafSize(float leaf_size) {
+    voxel_grid_.setLeafSize(leaf_size);
+}
+
+void FusedFilter::setVoxelMode(VoxelMode mode) {
+    voxel_grid_.setMode(mode);
+}
+
+bool FusedFilter::filter(const uint8_t *data, const PointBufferLayout &layout, CloudT &cloud_out) {
+
+    cloud_out.clear();
+
+    if (!data || layout.x_offset < 0 || layout.y_offset < 0 || layout.z_offset < 0) {
+        return false;
+    }
+
+    voxel_grid_.clear();
+
+    size_t n = 0;
+    for (uint32_t row = 0; row < layout.height; row++) {
+        const uint8_t *point = data + row * layout.row_step;
+        for (uint32_t col = 0; col < layout.width; col++, point += layout.point_step) {
+            batch_x_[n] = readFloat(point + layout.x_offset);
+            batch_y_[n] = readFloat(point + layout.y_offset);
+            batch_z_[n] = readFloat(point + layout.z_offset);
+            batch_rgb_[n] = 0;
+            if (layout.rgb_offset >= 0) {
+                std::memcpy(&batch_rgb_[n], point + layout.rgb_offset, sizeof(uint32_t));
+            }
+            if (++n == BATCH_SIZE) {
+                processBatch(n);
+                n = 0;
+            }
+        }
+    }
+    processBatch(n);
+
+    voxel_grid_.getCloud(cloud_out);
+
+    return !cloud_out.points.empty();
+}
+
+void FusedFilter::processBatch(size_t n) {
+
+    // NaN points and points outside of the box are dropped here
+    if (transformCropPoints(batch_x_, batch_y_, batch_z_, n, matrix_, &limits_[0], batch_keep_) == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (batch_keep_[i]) {
+            voxel_grid_.addPoint(batch_x_[i], batch_y_[i], batch_z_[i], batch_rgb_[i]);
+        }
+    }
+}
+
+void cropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const std::vector<float> &limits,
+                    pcl::PointCloud<pcl::PointXYZRGB> &cloud_out) {
+
+    const size_t batch_size = CLOUD_BATCH_SIZE;
+    const float identity[12] = {1.0f, 0.0f, 0.0f, 0.0f,
+                                0.0f, 1.0f, 0.0f, 0.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f};
+    float x[batch_size], y[batch_size], z[batch_size];
+    uint8_t keep[batch_size];
+
+    if (&cloud_in != &cloud_out) {
+        cloud_out.header = cloud_in.header;
+        cloud_out.points.resize(cloud_in.points.size());
+    }
+
+    // Points only move towards the front, so cropping in place is safe
+    size_t kept = 0;
+    for (size_t begin = 0; begin < cloud_in.points.size(); begin += batch_size) {
+        size_t n = std::min(batch_size, cloud_in.points.size() - begin);
+        for (size_t i = 0; i < n; i++) {
+            const pcl::PointXYZRGB &p = cloud_in.points[begin + i];
+            x[i] = p.x;
+            y[i] = p.y;
+            z[i] = p.z;
+        }
+        transformCropPoints(x, y, z, n, identity, &limits[0], keep);
+        for (size_t i = 0; i < n; i++) {
+            if (keep[i]) {
+                cloud_out.points[kept++] = cloud_in.points[begin + i];
+            }
+        }
+    }
+
+    cloud_out.points.resize(kept);
+    cloud_out.width = kept;
+    cloud_out.height = 1;
+    cloud_out.is_dense = true;
+}
+
+void cropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const std::vector<uint8_t> &inside,
+                    pcl::PointCloud<pcl::PointXYZRGB> &cloud_out) {
+
+    if (&cloud_in != &cloud_out) {
+        cloud_out.header = cloud_in.header;
+        cloud_out.points.resize(cloud_in.points.size());
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < cloud_in.points.size(); i++) {
+        if (inside[i]) {
+            cloud_out.points[kept++] = cloud_in.points[i];
+        }
+    }
+
+    cloud_out.points.resize(kept);
+    cloud_out.width = kept;
+    cloud_out.height = 1;
+    cloud_out.is_dense = true;
+}
+
+void transformCropPointCloud(const pcl::PointCloud<pcl::PointXYZRGB> &cloud_in, const Eigen::Affine3f &transform,
+                             const std::vector<float> &limits, pcl::PointCloud<pcl::PointXYZRGB> &cloud_out,
+                             std::vector<uint8_t> &inside) {
+
+    const size_t batch_size = CLOUD_BATCH_SIZE;
+    float matrix[12];
+    toRowMajor(transform, matrix);
+    float x[batch_size], y[batch_size], z[batch_size];
+
+    // Colors, layout and header come with the copy, only the coordinates
+    // are written back
+    if (&cloud_in != &cloud_out) {
+        cloud_out = cloud_in;
+    }
+    inside.resize(cloud_out.points.size());
+
+    for (size_t begin = 0; begin < cloud_out.points.size(); begin += batch_size) {
+        size_t n = std::min(batch_size, cloud_out.points.size() - begin);
+        for (size_t i = 0; i < n; i++) {
+            const pcl::PointXYZRGB &p = cloud_out.points[begin + i];
+            x[i] = p.x;
+            y[i] = p.y;
+            z[i] = p.z;
+        }
+        transformCropPoints(x, y, z, n, matrix, &limits[0], &inside[begin]);
+        for (size_t i = 0; i < n; i++) {
+            pcl::PointXYZRGB &p = cloud_out.points[begin + i];
+            p.x = x[i];
+            p.y = y[i];
+            p.z = z[i];
+        }
+    }
+}
+
+}
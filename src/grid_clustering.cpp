@@ -0,0 +1,202 @@
+#include <point_cloud_proc/grid_clustering.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace point_cloud_proc {
+
+namespace {
+
+// 21 bits per axis like the voxel grid
+inline uint64_t cellKey(int64_t i, int64_t j, int64_t k) {
+    const int64_t offset = 1 << 20;
+    const uint64_t mask = (1 << 21) - 1;
+    return (static_cast<uint64_t>(i + offset) & mask) << 42 |
+           (static_cast<uint64_t>(j + offset) & mask) << 21 |
+           (static_cast<uint64_t>(k + offset) & mask);
+}
+
+bool largerCluster(const pcl::PointIndices &a, const pcl::PointIndices &b) {
+    if (a.indices.size() != b.indices.size()) {
+        return a.indices.size() > b.indices.size();
+    }
+    return a.indices.front() < b.indices.front();
+}
+
+}
+
+bool clusterMethodFromString(const std::string &name, ClusterMethod &method) {
+    if (name == "kdtree") {
+        method = CLUSTER_KDTREE;
+    } else if (name == "grid") {
+        method = CLUSTER_GRID;
+    } else if (name == "organized") {
+        method = CLUSTER_ORGANIZED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+GridClustering::GridClustering() :
+        tolerance_(0.02f), min_size_(1), max_size_(std::numeric_limits<int>::max()) {
+}
+
+void GridClustering::setClusterTolerance(float tolerance) {
+    tolerance_ = tolerance;
+}
+
+void GridClustering::setMinClusterSize(int min_size) {
+    min_size_ = min_size;
+}
+
+void GridClustering::setMaxClusterSize(int max_size) {
+    max_size_ = max_size;
+}
+
+void GridClustering::setInputCloud(const CloudT::ConstPtr &cloud) {
+    cloud_ = cloud;
+}
+
+void GridClustering::setIndices(const pcl::PointIndices::ConstPtr &indices) {
+    indices_ = indices;
+}
+
+int GridClustering::findRoot(int cell) {
+    while (parent_[cell] != cell) {
+        parent_[cell] = parent_[parent_[cell]];
+        cell = parent_[cell];
+    }
+    return cell;
+}
+
+bool GridClustering::cellsConnected(int a, int b) const {
+    const float max_sqr_dist = tolerance_ * tolerance_;
+    for (int i = cell_start_[a]; i < cell_start_[a + 1]; i++) {
+        const PointT &p = cloud_->points[entries_[i].second];
+        for (int j = cell_start_[b]; j < cell_start_[b + 1]; j++) {
+            const PointT &q = cloud_->points[entries_[j].second];
+            float dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+            if (dx * dx + dy * dy + dz * dz <= max_sqr_dist) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void GridClustering::extract(std::vector<pcl::PointIndices> &clusters) {
+
+    clusters.clear();
+    if (!cloud_ || cloud_->points.empty() || tolerance_ <= 0.0f) {
+        return;
+    }
+
+    // The cell diagonal is just below the tolerance, any two points of a cell
+    // belong to the same cluster
+    const float cell_size = 0.999f * tolerance_ / std::sqrt(3.0f);
+    const float inverse_cell_size = 1.0f / cell_size;
+
+    entries_.clear();
+    const size_t num_points = indices_ ? indices_->indices.size() : cloud_->points.size();
+    for (size_t k = 0; k < num_points; k++) {
+        const int i = indices_ ? indices_->indices[k] : static_cast<int>(k);
+        const PointT &p = cloud_->points[i];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+            continue;
+        }
+        entries_.push_back(std::make_pair(cellKey(static_cast<int64_t>(std::floor(p.x * inverse_cell_size)),
+                                                  static_cast<int64_t>(std::floor(p.y * inverse_cell_size)),
+                                                  static_cast<int64_t>(std::floor(p.z * inverse_cell_size))),
+                                          i));
+    }
+    std::sort(entries_.begin(), entries_.end());
+
+    cell_start_.clear();
+    cell_coords_.clear();
+    cell_map_.clear();
+    for (size_t i = 0; i < entries_.size(); i++) {
+        if (i > 0 && entries_[i].first == entries_[i - 1].first) {
+            continue;
+        }
+        const PointT &p = cloud_->points[entries_[i].second];
+        cell_map_[entries_[i].first] = static_cast<int>(cell_start_.size());
+        cell_start_.push_back(static_cast<int>(i));
+        cell_coords_.push_back(static_cast<int>(std::floor(p.x * inverse_cell_size)));
+        cell_coords_.push_back(static_cast<int>(std::floor(p.y * inverse_cell_size)));
+        cell_coords_.push_back(static_cast<int>(std::floor(p.z * inverse_cell_size)));
+    }
+    const int num_cells = static_cast<int>(cell_start_.size());
+    cell_start_.push_back(static_cast<int>(entries_.size()));
+
+    parent_.resize(num_cells);
+    for (int i = 0; i < num_cells; i++) {
+        parent_[i] = i;
+    }
+
+    // Neighbour cells that can hold a point within the tolerance, only one
+    // of each pair of opposite offsets so every pair of cells is seen once
+    std::vector<int> offsets;
+    for (int dx = -2; dx <= 2; dx++) {
+        for (int dy = -2; dy <= 2; dy++) {
+            for (int dz = -2; dz <= 2; dz++) {
+                if (dx < 0 || (dx == 0 && (dy < 0 || (dy == 0 && dz <= 0)))) {
+                    continue;
+                }
+                float gap_x = std::max(0, std::abs(dx) - 1) * cell_size;
+                float gap_y = std::max(0, std::abs(dy) - 1) * cell_size;
+                float gap_z = std::max(0, std::abs(dz) - 1) * cell_size;
+                if (gap_x * gap_x + gap_y * gap_y + gap_z * gap_z <= tolerance_ * tolerance_) {
+                    offsets.push_back(dx);
+                    offsets.push_back(dy);
+                    offsets.push_back(dz);
+                }
+            }
+        }
+    }
+
+    for (int a = 0; a < num_cells; a++) {
+        const int *coords = &cell_coords_[3 * a];
+        for (size_t o = 0; o < offsets.size(); o += 3) {
+            std::unordered_map<uint64_t, int>::const_iterator neighbor = cell_map_.find(
+                    cellKey(coords[0] + offsets[o], coords[1] + offsets[o + 1], coords[2] + offsets[o + 2]));
+            if (neighbor == cell_map_.end()) {
+                continue;
+            }
+            int root_a = findRoot(a), root_b = findRoot(neighbor->second);
+            if (root_a != root_b && cellsConnected(a, neighbor->second)) {
+                parent_[root_b] = root_a;
+            }
+        }
+    }
+
+    // Gather the points of every component
+    std::vector<int> component(num_cells, -1);
+    std::vector<pcl::PointIndices> components;
+    for (int c = 0; c < num_cells; c++) {
+        int root = findRoot(c);
+        if (component[root] < 0) {
+            component[root] = static_cast<int>(components.size());
+            components.push_back(pcl::PointIndices());
+        }
+        std::vector<int> &indices = components[component[root]].indices;
+        for (int i = cell_start_[c]; i < cell_start_[c + 1]; i++) {
+            indices.push_back(entries_[i].second);
+        }
+    }
+
+    for (pcl::PointIndices &cluster : components) {
+        int size = static_cast<int>(cluster.indices.size());
+        if (size < min_size_ || size > max_size_) {
+            continue;
+        }
+        std::sort(cluster.indices.begin(), cluster.indices.end());
+        clusters.push_back(pcl::PointIndices());
+        clusters.back().indices.swap(cluster.indices);
+        clusters.back().header = cloud_->header;
+    }
+    std::sort(clusters.begin(), clusters.end(), largerCluster);
+}
+
+}
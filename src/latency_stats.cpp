@@ -0,0 +1,59 @@
+#include <point_cloud_proc/latency_stats.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace point_cloud_proc {
+
+namespace {
+
+// Nearest rank percentile of sorted samples
+double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+}
+
+LatencyStats::LatencyStats(size_t window) :
+        window_(window), next_(0), count_(0), sum_ms_(0.0), max_ms_(0.0) {
+}
+
+void LatencyStats::add(double ms) {
+    if (window_ == 0 || samples_.size() < window_) {
+        samples_.push_back(ms);
+    } else {
+        samples_[next_] = ms;
+        next_ = (next_ + 1) % window_;
+    }
+    count_++;
+    sum_ms_ += ms;
+    max_ms_ = std::max(max_ms_, ms);
+}
+
+void LatencyStats::reset() {
+    samples_.clear();
+    next_ = 0;
+    count_ = 0;
+    sum_ms_ = 0.0;
+    max_ms_ = 0.0;
+}
+
+LatencySummary LatencyStats::summary() const {
+    LatencySummary summary;
+    if (count_ == 0) {
+        return summary;
+    }
+    std::vector<double> sorted(samples_);
+    std::sort(sorted.begin(), sorted.end());
+
+    summary.count = count_;
+    summary.mean_ms = sum_ms_ / count_;
+    summary.p50_ms = percentile(sorted, 50.0);
+    summary.p95_ms = percentile(sorted, 95.0);
+    summary.p99_ms = percentile(sorted, 99.0);
+    summary.max_ms = max_ms_;
+    return summary;
+}
+
+}
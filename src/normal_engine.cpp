@@ -0,0 +1,115 @@
+#include <point_cloud_proc/normal_engine.h>
+
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace point_cloud_proc {
+
+template <typename PointT>
+NormalEngine<PointT>::NormalEngine() :
+        tree_(new pcl::search::KdTree<PointT>), normals_(new CloudNT), partial_normals_(new CloudNT),
+        threads_(0), k_(50), valid_(false), all_points_(false), width_(0), height_(0), cached_k_(0) {
+}
+
+template <typename PointT>
+void NormalEngine<PointT>::setNumberOfThreads(int threads) {
+    threads_ = threads;
+}
+
+template <typename PointT>
+void NormalEngine<PointT>::setKSearch(int k) {
+    k_ = k;
+}
+
+template <typename PointT>
+void NormalEngine<PointT>::invalidate() {
+    valid_ = false;
+    source_ = NormalSource();
+}
+
+template <typename PointT>
+typename NormalEngine<PointT>::CloudNT::ConstPtr
+NormalEngine<PointT>::compute(const typename CloudT::ConstPtr &cloud, const pcl::PointIndices::ConstPtr &indices,
+                              const NormalSource &source) {
+
+    // The cloud pointer is no key, clouds are recycled between frames and
+    // each caller has its own
+    if (valid_ && source.matches(source_) && width_ == cloud->width && height_ == cloud->height &&
+        cached_k_ == k_ && all_points_ == !indices && (!indices || indices_ == indices->indices)) {
+        return normals_;
+    }
+
+    // Callers may still hold the last result
+    if (!normals_.unique()) {
+        normals_.reset(new CloudNT);
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = threads_ > 0 ? threads_ : omp_get_max_threads();
+#endif
+    ne_.setNumberOfThreads(threads);
+    ne_.setKSearch(k_);
+    ne_.setInputCloud(cloud);
+
+    if (indices) {
+        // Only the points in indices are searched, so the neighbourhoods are
+        // those of the extracted points. The feature keeps a tree that
+        // already holds its input cloud, the indices of the tree stay.
+        tree_->setInputCloud(cloud, pcl::IndicesConstPtr(indices, &indices->indices));
+        ne_.setSearchMethod(tree_);
+
+        // Normals of the indices only, spread back to their points
+        ne_.setIndices(indices);
+        ne_.compute(*partial_normals_);
+        ne_.setIndices(pcl::IndicesPtr());
+
+        pcl::Normal invalid;
+        invalid.normal_x = invalid.normal_y = invalid.normal_z = invalid.curvature =
+                std::numeric_limits<float>::quiet_NaN();
+        normals_->points.assign(cloud->points.size(), invalid);
+        for (size_t i = 0; i < indices->indices.size(); i++) {
+            normals_->points[indices->indices[i]] = partial_normals_->points[i];
+        }
+        normals_->width = cloud->width;
+        normals_->height = cloud->height;
+        normals_->is_dense = false;
+        normals_->header = cloud->header;
+    } else {
+        tree_->setInputCloud(cloud);
+        ne_.setSearchMethod(tree_);
+        ne_.compute(*normals_);
+    }
+
+    valid_ = true;
+    all_points_ = !indices;
+    source_ = source;
+    width_ = cloud->width;
+    height_ = cloud->height;
+    cached_k_ = k_;
+    if (source.message && indices) {
+        indices_ = indices->indices;
+    } else {
+        indices_.clear();
+    }
+    return normals_;
+}
+
+template class NormalEngine<pcl::PointXYZ>;
+template class NormalEngine<pcl::PointXYZRGB>;
+
+void sliceNormals(const pcl::PointCloud<pcl::Normal> &normals, const std::vector<int> &indices,
+                  pcl::PointCloud<pcl::Normal> &sliced) {
+    sliced.points.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        sliced.points[i] = normals.points[indices[i]];
+    }
+    sliced.width = sliced.points.size();
+    sliced.height = 1;
+    sliced.header = normals.header;
+}
+
+}
@@ -0,0 +1,67 @@
+#include <point_cloud_proc/organized_clustering.h>
+#include <pcl/segmentation/organized_connected_component_segmentation.h>
+
+#include <algorithm>
+
+namespace point_cloud_proc {
+
+MaskedEuclideanComparator::MaskedEuclideanComparator() : sqr_threshold_(0.0004f) {
+}
+
+void MaskedEuclideanComparator::setMask(const std::vector<uint8_t> &mask) {
+    mask_ = mask;
+}
+
+void MaskedEuclideanComparator::setDistanceThreshold(float threshold) {
+    sqr_threshold_ = threshold * threshold;
+}
+
+bool MaskedEuclideanComparator::compare(int idx1, int idx2) const {
+    if (!mask_[idx1] || !mask_[idx2]) {
+        return false;
+    }
+    const pcl::PointXYZRGB &p = input_->points[idx1];
+    const pcl::PointXYZRGB &q = input_->points[idx2];
+    float dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+    return dx * dx + dy * dy + dz * dz <= sqr_threshold_;
+}
+
+void extractOrganizedClusters(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                              const std::vector<int> &indices, float tolerance, int min_size, int max_size,
+                              std::vector<pcl::PointIndices> &clusters) {
+
+    clusters.clear();
+
+    std::vector<uint8_t> mask(cloud->points.size(), 0);
+    for (int index : indices) {
+        mask[index] = 1;
+    }
+
+    MaskedEuclideanComparator::Ptr comparator(new MaskedEuclideanComparator);
+    comparator->setInputCloud(cloud);
+    comparator->setMask(mask);
+    comparator->setDistanceThreshold(tolerance);
+
+    pcl::PointCloud<pcl::Label> labels;
+    std::vector<pcl::PointIndices> label_indices;
+    pcl::OrganizedConnectedComponentSegmentation<pcl::PointXYZRGB, pcl::Label> segmentation(comparator);
+    segmentation.setInputCloud(cloud);
+    segmentation.segment(labels, label_indices);
+
+    // Pixels outside the mask end up in labels of their own and are dropped
+    for (pcl::PointIndices &label : label_indices) {
+        int size = static_cast<int>(label.indices.size());
+        if (size == 0 || size < min_size || size > max_size || !mask[label.indices.front()]) {
+            continue;
+        }
+        clusters.push_back(pcl::PointIndices());
+        clusters.back().indices.swap(label.indices);
+        clusters.back().header = cloud->header;
+    }
+
+    std::sort(clusters.begin(), clusters.end(), [](const pcl::PointIndices &a, const pcl::PointIndices &b) {
+        return a.indices.size() > b.indices.size();
+    });
+}
+
+}
@@ -0,0 +1,241 @@
+#include <point_cloud_proc/plane_hull.h>
+#include <point_cloud_proc/cloud_view.h>
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace point_cloud_proc {
+
+namespace {
+
+// Cells of the raster, larger hulls get larger cells
+const size_t MAX_CELLS = 1 << 22;
+
+inline float cross(const Eigen::Vector2f &o, const Eigen::Vector2f &a, const Eigen::Vector2f &b) {
+    return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+}
+
+PlaneHull::PlaneHull() :
+        cell_size_(0.02f), height_min_(-std::numeric_limits<float>::max()),
+        height_max_(std::numeric_limits<float>::max()), normal_(Eigen::Vector3f::UnitZ()),
+        u_(Eigen::Vector3f::UnitX()), v_(Eigen::Vector3f::UnitY()), d_(0.0f),
+        raster_cell_size_(0.02f), min_a_(0.0f), min_b_(0.0f), cols_(0), rows_(0) {
+}
+
+void PlaneHull::setCellSize(float cell_size) {
+    cell_size_ = cell_size;
+}
+
+void PlaneHull::setHeightLimits(float height_min, float height_max) {
+    height_min_ = height_min;
+    height_max_ = height_max;
+}
+
+void PlaneHull::planeBasis(const Eigen::Vector3f &normal, Eigen::Vector3f &u, Eigen::Vector3f &v) {
+    // Any direction not parallel to the normal
+    Eigen::Vector3f reference = std::abs(normal[0]) < 0.9f ? Eigen::Vector3f::UnitX() : Eigen::Vector3f::UnitY();
+    u = normal.cross(reference).normalized();
+    v = normal.cross(u);
+}
+
+void PlaneHull::computeHull(const CloudT &cloud, const std::vector<int> *indices,
+                            const pcl::ModelCoefficients &coefficients, CloudT &hull) {
+
+    CloudView view(cloud, indices);
+    hull.clear();
+    hull.header = cloud.header;
+    if (coefficients.values.size() != 4 || view.empty()) {
+        return;
+    }
+
+    Eigen::Vector3f normal(coefficients.values[0], coefficients.values[1], coefficients.values[2]);
+    Eigen::Vector3f u, v;
+    planeBasis(normal.normalized(), u, v);
+
+    projected_.resize(view.size());
+    order_.resize(view.size());
+    for (size_t i = 0; i < view.size(); i++) {
+        Eigen::Vector3f p = view[i].getVector3fMap();
+        projected_[i] = Eigen::Vector2f(u.dot(p), v.dot(p));
+        order_[i] = static_cast<int>(i);
+    }
+    std::sort(order_.begin(), order_.end(), [this](int a, int b) {
+        return projected_[a][0] < projected_[b][0] ||
+               (projected_[a][0] == projected_[b][0] && projected_[a][1] < projected_[b][1]);
+    });
+
+    // Lower chain left to right, upper chain right to left, collinear points
+    // are dropped
+    chain_.assign(2 * order_.size(), 0);
+    size_t k = 0;
+    for (size_t i = 0; i < order_.size(); i++) {
+        while (k >= 2 && cross(projected_[chain_[k - 2]], projected_[chain_[k - 1]], projected_[order_[i]]) <= 0.0f) {
+            k--;
+        }
+        chain_[k++] = order_[i];
+    }
+    for (size_t i = order_.size() - 1, lower = k + 1; i > 0; i--) {
+        while (k >= lower && cross(projected_[chain_[k - 2]], projected_[chain_[k - 1]], projected_[order_[i - 1]]) <= 0.0f) {
+            k--;
+        }
+        chain_[k++] = order_[i - 1];
+    }
+    // The last point closes the chain
+    if (k > 1) {
+        k--;
+    }
+
+    hull.points.resize(k);
+    for (size_t i = 0; i < k; i++) {
+        hull.points[i] = view[chain_[i]];
+    }
+    hull.width = hull.points.size();
+    hull.height = 1;
+    hull.is_dense = true;
+}
+
+bool PlaneHull::setHull(const CloudT &hull) {
+
+    if (hull.points.size() < 3) {
+        polygon_.clear();
+        hull_.clear();
+        return false;
+    }
+
+    // Same hull as the last frame, the raster is still valid
+    bool same = hull.points.size() == hull_.points.size();
+    for (size_t i = 0; same && i < hull.points.size(); i++) {
+        same = hull.points[i].getVector3fMap() == hull_.points[i].getVector3fMap();
+    }
+    if (same) {
+        return true;
+    }
+    hull_ = hull;
+
+    // Plane fit to the hull points and normal towards the viewpoint like
+    // ExtractPolygonalPrismData
+    Eigen::Vector3d centroid;
+    Eigen::Matrix3d covariance;
+    computeCovariance(CloudView(hull), centroid, covariance);
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    normal_ = solver.eigenvectors().col(0).cast<float>();
+    d_ = -normal_.dot(centroid.cast<float>());
+
+    const Eigen::Vector3f first = hull.points[0].getVector3fMap();
+    if (normal_.dot(-first) < 0.0f) {
+        normal_ = -normal_;
+        d_ = -normal_.dot(first);
+    }
+    planeBasis(normal_, u_, v_);
+
+    polygon_.resize(hull.points.size());
+    float area = 0.0f;
+    for (size_t i = 0; i < hull.points.size(); i++) {
+        Eigen::Vector3f p = hull.points[i].getVector3fMap();
+        polygon_[i] = Eigen::Vector2f(u_.dot(p), v_.dot(p));
+    }
+    for (size_t i = 0; i < polygon_.size(); i++) {
+        const Eigen::Vector2f &a = polygon_[i], &b = polygon_[(i + 1) % polygon_.size()];
+        area += a[0] * b[1] - b[0] * a[1];
+    }
+    if (area < 0.0f) {
+        std::reverse(polygon_.begin(), polygon_.end());
+    }
+
+    rasterize();
+    return true;
+}
+
+bool PlaneHull::insidePolygon(float a, float b) const {
+    const Eigen::Vector2f q(a, b);
+    for (size_t i = 0; i < polygon_.size(); i++) {
+        if (cross(polygon_[i], polygon_[(i + 1) % polygon_.size()], q) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PlaneHull::rasterize() {
+
+    Eigen::Vector2f min_pt = polygon_[0], max_pt = polygon_[0];
+    for (const Eigen::Vector2f &p : polygon_) {
+        min_pt = min_pt.cwiseMin(p);
+        max_pt = max_pt.cwiseMax(p);
+    }
+
+    float cell_size = cell_size_;
+    Eigen::Vector2f extent = max_pt - min_pt;
+    while (static_cast<size_t>(extent[0] / cell_size + 1) * static_cast<size_t>(extent[1] / cell_size + 1) > MAX_CELLS) {
+        cell_size *= 2.0f;
+    }
+    raster_cell_size_ = cell_size;
+    min_a_ = min_pt[0];
+    min_b_ = min_pt[1];
+    cols_ = static_cast<int>(extent[0] / cell_size) + 1;
+    rows_ = static_cast<int>(extent[1] / cell_size) + 1;
+    cells_.assign(static_cast<size_t>(cols_) * rows_, CELL_BOUNDARY);
+
+    // A cell is inside when its corners are, the polygon is convex. It is
+    // outside when an edge of the polygon separates it.
+    for (int row = 0; row < rows_; row++) {
+        for (int col = 0; col < cols_; col++) {
+            Eigen::Vector2f corners[4];
+            corners[0] = Eigen::Vector2f(min_a_ + col * cell_size, min_b_ + row * cell_size);
+            corners[1] = corners[0] + Eigen::Vector2f(cell_size, 0.0f);
+            corners[2] = corners[0] + Eigen::Vector2f(cell_size, cell_size);
+            corners[3] = corners[0] + Eigen::Vector2f(0.0f, cell_size);
+
+            bool all_inside = true, separated = false;
+            for (size_t i = 0; i < polygon_.size() && !separated; i++) {
+                const Eigen::Vector2f &a = polygon_[i], &b = polygon_[(i + 1) % polygon_.size()];
+                int outside = 0;
+                for (int c = 0; c < 4; c++) {
+                    outside += cross(a, b, corners[c]) < 0.0f;
+                }
+                all_inside = all_inside && outside == 0;
+                separated = outside == 4;
+            }
+            uint8_t &cell = cells_[static_cast<size_t>(row) * cols_ + col];
+            cell = separated ? CELL_OUTSIDE : (all_inside ? CELL_INSIDE : CELL_BOUNDARY);
+        }
+    }
+}
+
+void PlaneHull::segment(const CloudT &cloud, const std::vector<int> *indices, std::vector<int> &inside) {
+
+    inside.clear();
+    if (polygon_.size() < 3) {
+        return;
+    }
+
+    const float inverse_cell_size = 1.0f / raster_cell_size_;
+    size_t num_points = indices ? indices->size() : cloud.points.size();
+    for (size_t i = 0; i < num_points; i++) {
+        int index = indices ? (*indices)[i] : static_cast<int>(i);
+        Eigen::Vector3f p = cloud.points[index].getVector3fMap();
+
+        // NaN points fail the height test
+        float height = normal_.dot(p) + d_;
+        if (!(height >= height_min_ && height <= height_max_)) {
+            continue;
+        }
+
+        float a = u_.dot(p), b = v_.dot(p);
+        int col = static_cast<int>(std::floor((a - min_a_) * inverse_cell_size));
+        int row = static_cast<int>(std::floor((b - min_b_) * inverse_cell_size));
+        if (col < 0 || row < 0 || col >= cols_ || row >= rows_) {
+            continue;
+        }
+        uint8_t cell = cells_[static_cast<size_t>(row) * cols_ + col];
+        if (cell == CELL_INSIDE || (cell == CELL_BOUNDARY && insidePolygon(a, b))) {
+            inside.push_back(index);
+        }
+    }
+}
+
+}
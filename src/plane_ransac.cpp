@@ -0,0 +1,219 @@
+#include <point_cloud_proc/plane_ransac.h>
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace point_cloud_proc {
+
+const int ParallelPlaneRansac::BATCH_SIZE;
+
+ParallelPlaneRansac::ParallelPlaneRansac() :
+        threshold_(0.01f), max_iterations_(1000), threads_(0), iterations_(0), probability_(0.99),
+        axis_(Eigen::Vector3f::Zero()), eps_angle_(0.0f), seed_(0) {
+}
+
+void ParallelPlaneRansac::setInputCloud(const CloudT::ConstPtr &cloud) {
+    cloud_ = cloud;
+}
+
+void ParallelPlaneRansac::setIndices(const pcl::PointIndices::ConstPtr &indices) {
+    indices_ = indices;
+}
+
+void ParallelPlaneRansac::setDistanceThreshold(float threshold) {
+    threshold_ = threshold;
+}
+
+void ParallelPlaneRansac::setMaxIterations(int max_iterations) {
+    max_iterations_ = max_iterations;
+}
+
+void ParallelPlaneRansac::setProbability(double probability) {
+    probability_ = probability;
+}
+
+void ParallelPlaneRansac::setAxis(const Eigen::Vector3f &axis, float eps_angle) {
+    axis_ = axis.norm() > 0.0f ? axis.normalized() : Eigen::Vector3f::Zero();
+    eps_angle_ = eps_angle;
+}
+
+void ParallelPlaneRansac::setSeed(unsigned int seed) {
+    seed_ = seed;
+}
+
+void ParallelPlaneRansac::setNumberOfThreads(int threads) {
+    threads_ = threads;
+}
+
+int ParallelPlaneRansac::getIterations() const {
+    return iterations_;
+}
+
+bool ParallelPlaneRansac::isDegenerate(const Eigen::Vector4f &model) const {
+    if (!std::isfinite(model[3])) {
+        return true;
+    }
+    if (axis_.isZero()) {
+        return false;
+    }
+    float cos_angle = std::min(1.0f, std::abs(model.head<3>().dot(axis_)));
+    return std::acos(cos_angle) > eps_angle_;
+}
+
+size_t ParallelPlaneRansac::countInliers(const Eigen::Vector4f &model) const {
+    const float a = model[0], b = model[1], c = model[2], d = model[3];
+    const float *x = x_.data(), *y = y_.data(), *z = z_.data();
+    size_t count = 0;
+    for (size_t i = 0; i < x_.size(); i++) {
+        count += std::abs(a * x[i] + b * y[i] + c * z[i] + d) <= threshold_;
+    }
+    return count;
+}
+
+void ParallelPlaneRansac::selectInliers(const Eigen::Vector4f &model, std::vector<int> &inliers) const {
+    inliers.clear();
+    for (size_t i = 0; i < x_.size(); i++) {
+        if (std::abs(model[0] * x_[i] + model[1] * y_[i] + model[2] * z_[i] + model[3]) <= threshold_) {
+            inliers.push_back(point_indices_[i]);
+        }
+    }
+}
+
+bool ParallelPlaneRansac::segment(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients) {
+
+    inliers.indices.clear();
+    coefficients.values.clear();
+    iterations_ = 0;
+    if (!cloud_) {
+        return false;
+    }
+
+    // Gather the finite points once into contiguous arrays for scoring
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    point_indices_.clear();
+    bool all_points = !indices_ || indices_->indices.empty();
+    size_t num_points = all_points ? cloud_->points.size() : indices_->indices.size();
+    for (size_t i = 0; i < num_points; i++) {
+        int index = all_points ? static_cast<int>(i) : indices_->indices[i];
+        const PointT &p = cloud_->points[index];
+        if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) {
+            x_.push_back(p.x);
+            y_.push_back(p.y);
+            z_.push_back(p.z);
+            point_indices_.push_back(index);
+        }
+    }
+
+    const int n = static_cast<int>(x_.size());
+    if (n < 3) {
+        return false;
+    }
+
+    // The generator is reset on every call so the same input gives the same
+    // plane
+    std::mt19937 rng(seed_);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+
+    std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > models(BATCH_SIZE);
+    std::vector<size_t> scores(BATCH_SIZE);
+
+    Eigen::Vector4f best_model;
+    size_t best_score = 0;
+    double needed_iterations = max_iterations_;
+    const double log_probability = std::log(1.0 - probability_);
+
+#ifdef _OPENMP
+    const int threads = threads_ > 0 ? threads_ : omp_get_max_threads();
+#endif
+
+    while (iterations_ < needed_iterations && iterations_ < max_iterations_) {
+
+        // Samples are drawn serially, only the scoring runs in parallel
+        int batch = std::min(BATCH_SIZE, max_iterations_ - iterations_);
+        for (int h = 0; h < batch; h++) {
+            int i0 = pick(rng), i1 = pick(rng), i2 = pick(rng);
+            Eigen::Vector3f p0(x_[i0], y_[i0], z_[i0]);
+            Eigen::Vector3f normal = (Eigen::Vector3f(x_[i1], y_[i1], z_[i1]) - p0).cross(
+                    Eigen::Vector3f(x_[i2], y_[i2], z_[i2]) - p0);
+            float norm = normal.norm();
+            if (i0 == i1 || i0 == i2 || i1 == i2 || norm < std::numeric_limits<float>::epsilon()) {
+                models[h][3] = std::numeric_limits<float>::quiet_NaN();
+                continue;
+            }
+            normal /= norm;
+            models[h] << normal, -normal.dot(p0);
+        }
+
+        #pragma omp parallel for schedule(dynamic, 4) num_threads(threads)
+        for (int h = 0; h < batch; h++) {
+            scores[h] = isDegenerate(models[h]) ? 0 : countInliers(models[h]);
+        }
+
+        // Strictly better only, ties keep the earlier hypothesis
+        for (int h = 0; h < batch; h++) {
+            if (scores[h] > best_score) {
+                best_score = scores[h];
+                best_model = models[h];
+            }
+        }
+        iterations_ += batch;
+
+        if (best_score > 0) {
+            double w = static_cast<double>(best_score) / n;
+            double p_no_outliers = std::max(std::numeric_limits<double>::epsilon(),
+                                            std::min(1.0 - std::numeric_limits<double>::epsilon(), 1.0 - w * w * w));
+            needed_iterations = log_probability / std::log(p_no_outliers);
+        }
+    }
+
+    if (best_score < 3) {
+        return false;
+    }
+
+    // Least squares refit on the inliers of the best hypothesis
+    std::vector<int> &best_inliers = inliers.indices;
+    selectInliers(best_model, best_inliers);
+
+    Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+    for (int index : best_inliers) {
+        const PointT &p = cloud_->points[index];
+        centroid += Eigen::Vector3d(p.x, p.y, p.z);
+    }
+    centroid /= best_inliers.size();
+
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for (int index : best_inliers) {
+        const PointT &p = cloud_->points[index];
+        Eigen::Vector3d diff = Eigen::Vector3d(p.x, p.y, p.z) - centroid;
+        covariance += diff * diff.transpose();
+    }
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    Eigen::Vector3f normal = solver.eigenvectors().col(0).cast<float>();
+    if (normal.dot(best_model.head<3>()) < 0.0f) {
+        normal = -normal;
+    }
+    Eigen::Vector4f refined;
+    refined << normal, -normal.dot(centroid.cast<float>());
+    if (refined.allFinite()) {
+        best_model = refined;
+        selectInliers(best_model, best_inliers);
+    }
+
+    coefficients.values.resize(4);
+    for (int i = 0; i < 4; i++) {
+        coefficients.values[i] = best_model[i];
+    }
+    return !best_inliers.empty();
+}
+
+}
@@ -0,0 +1,161 @@
+#include <point_cloud_proc/plane_tracker.h>
+#include <Eigen/Eigenvalues>
+
+#include <cmath>
+#include <limits>
+
+namespace point_cloud_proc {
+
+PlaneTracker::PlaneTracker() :
+        threshold_(0.01f), min_inlier_ratio_(0.8f), hull_tolerance_(0.02f), eps_angle_(static_cast<float>(M_PI)),
+        has_plane_(false), hull_valid_(false), hull_updated_(false), num_inliers_(0), generation_(0) {
+}
+
+void PlaneTracker::setDistanceThreshold(float threshold) {
+    threshold_ = threshold;
+}
+
+void PlaneTracker::setMinInlierRatio(float ratio) {
+    min_inlier_ratio_ = ratio;
+}
+
+void PlaneTracker::setHullTolerance(float tolerance) {
+    hull_tolerance_ = tolerance;
+}
+
+void PlaneTracker::setEpsAngle(float eps_angle) {
+    eps_angle_ = eps_angle;
+}
+
+void PlaneTracker::reset() {
+    has_plane_ = false;
+    hull_valid_ = false;
+    num_inliers_ = 0;
+    hull_.clear();
+    generation_++;
+}
+
+bool PlaneTracker::hasPlane() const {
+    return has_plane_;
+}
+
+bool PlaneTracker::track(const CloudT &cloud, const Eigen::Vector3f &axis,
+                         pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients) {
+
+    hull_valid_ = false;
+    hull_updated_ = false;
+    if (!has_plane_ || !axis.isApprox(axis_)) {
+        return false;
+    }
+
+    // Inliers, their moments for the refit and their extent in one pass
+    inliers.indices.clear();
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_sq = Eigen::Matrix3d::Zero();
+    Eigen::Vector3f min_pt = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max_pt = -min_pt;
+
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        const PointT &p = cloud.points[i];
+        float distance = model_[0] * p.x + model_[1] * p.y + model_[2] * p.z + model_[3];
+        if (std::abs(distance) <= threshold_) {
+            inliers.indices.push_back(static_cast<int>(i));
+            Eigen::Vector3d q(p.x, p.y, p.z);
+            sum += q;
+            sum_sq += q * q.transpose();
+            min_pt = min_pt.cwiseMin(p.getVector3fMap());
+            max_pt = max_pt.cwiseMax(p.getVector3fMap());
+        }
+    }
+
+    size_t count = inliers.indices.size();
+    if (count < 3 || count < min_inlier_ratio_ * num_inliers_) {
+        inliers.indices.clear();
+        return false;
+    }
+
+    Eigen::Vector3d centroid = sum / count;
+    Eigen::Matrix3d covariance = sum_sq / count - centroid * centroid.transpose();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    Eigen::Vector3f normal = solver.eigenvectors().col(0).cast<float>();
+    if (normal.dot(model_.head<3>()) < 0.0f) {
+        normal = -normal;
+    }
+    if (!normal.allFinite()) {
+        inliers.indices.clear();
+        return false;
+    }
+    // RANSAC would not accept a refitted plane that tilted away from the axis
+    if (!axis.isZero() && std::abs(normal.dot(axis.normalized())) < std::cos(eps_angle_)) {
+        inliers.indices.clear();
+        return false;
+    }
+    model_ << normal, -normal.dot(centroid.cast<float>());
+
+    coefficients.values.resize(4);
+    for (int i = 0; i < 4; i++) {
+        coefficients.values[i] = model_[i];
+    }
+
+    hull_valid_ = !hull_.empty() &&
+                  (min_pt - hull_min_).cwiseAbs().maxCoeff() <= hull_tolerance_ &&
+                  (max_pt - hull_max_).cwiseAbs().maxCoeff() <= hull_tolerance_;
+    return true;
+}
+
+bool PlaneTracker::hullValid() const {
+    return hull_valid_;
+}
+
+const PlaneTracker::CloudT &PlaneTracker::getHull() const {
+    return hull_;
+}
+
+void PlaneTracker::accept(const PlaneTracker &tracked) {
+    if (has_plane_ && tracked.generation_ == generation_) {
+        model_ = tracked.model_;
+        if (tracked.hull_updated_) {
+            hull_min_ = tracked.hull_min_;
+            hull_max_ = tracked.hull_max_;
+            hull_ = tracked.hull_;
+        }
+    }
+}
+
+void PlaneTracker::update(const CloudT &cloud, const std::vector<int> &inliers,
+                          const pcl::ModelCoefficients &coefficients, const Eigen::Vector3f &axis,
+                          const CloudT &hull) {
+
+    if (inliers.empty() || coefficients.values.size() != 4) {
+        reset();
+        return;
+    }
+
+    model_ << coefficients.values[0], coefficients.values[1], coefficients.values[2], coefficients.values[3];
+    axis_ = axis;
+    num_inliers_ = inliers.size();
+    setHull(cloud, inliers, hull);
+    has_plane_ = true;
+    generation_++;
+}
+
+void PlaneTracker::updateHull(const CloudT &cloud, const std::vector<int> &inliers, const CloudT &hull) {
+    if (!has_plane_ || inliers.empty()) {
+        return;
+    }
+    setHull(cloud, inliers, hull);
+    hull_updated_ = true;
+}
+
+void PlaneTracker::setHull(const CloudT &cloud, const std::vector<int> &inliers, const CloudT &hull) {
+    hull_min_ = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    hull_max_ = -hull_min_;
+    for (int index : inliers) {
+        hull_min_ = hull_min_.cwiseMin(cloud.points[index].getVector3fMap());
+        hull_max_ = hull_max_.cwiseMax(cloud.points[index].getVector3fMap());
+    }
+    hull_ = hull;
+    hull_valid_ = true;
+}
+
+}
@@ -1,14 +1,65 @@
 #include <point_cloud_proc/point_cloud_proc.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+// Copies the points of view straight into the message, without a cloud in
+// between
+void toROSMsg(const point_cloud_proc::CloudView &view, sensor_msgs::PointCloud2 &msg) {
+    pcl::PCLPointCloud2 pcl_msg;
+    point_cloud_proc::toPCLPointCloud2(view, pcl_msg);
+    pcl_conversions::moveFromPCL(pcl_msg, msg);
+}
+
+}
+
 PointCloudProc::PointCloudProc(ros::NodeHandle n, bool debug, std::string config) :
-        nh_(n), debug_(debug), cloud_transformed_(new CloudT), cloud_filtered_(new CloudT),
-        cloud_hull_(new CloudT), cloud_tabletop_(new CloudT) {
+        debug_(debug), offline_(false), nh_(new ros::NodeHandle(n)) {
+
+    YAML::Node parameters = loadConfig(config);
+
+    tf_listener_.reset(new tf2_ros::TransformListener(tf_buffer_, *nh_));
+    point_cloud_sub_ = nh_->subscribe(point_cloud_topic_, 10, &PointCloudProc::pointCloudCb, this);
+
+    if (debug_) {
+        plane_cloud_pub_ = nh_->advertise<sensor_msgs::PointCloud2>("plane_cloud", 10, true);
+        debug_cloud_pub_ = nh_->advertise<sensor_msgs::PointCloud2>("debug_cloud", 10, true);
+        tabletop_pub_ = nh_->advertise<sensor_msgs::PointCloud2>("tabletop_cloud", 10, true);
+        object_poses_pub_ = nh_->advertise<geometry_msgs::PoseArray>("object_poses", 10, true);
+        point_pub_  = nh_->advertise<geometry_msgs::PointStamped>("object_points", 10, true);
+    }
+
+    ROS_DEBUG("PCP: point kernels use %s", point_cloud_proc::simdLevelName(point_cloud_proc::simdLevel()));
+
+    double diagnostics_period = parameters["diagnostics_period"].as<double>(0.0);
+    if (diagnostics_period > 0.0) {
+        stage_stats_.setEnabled(true);
+        diagnostics_pub_ = nh_->advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 1);
+        diagnostics_timer_ = nh_->createWallTimer(ros::WallDuration(diagnostics_period),
+                                                  &PointCloudProc::publishDiagnostics, this);
+    }
+
+    if (parameters["streaming"].as<bool>(false)) {
+        startStreaming();
+    }
+}
+
+PointCloudProc::PointCloudProc(std::string config, const ros::Duration &tf_cache_time) :
+        debug_(false), offline_(true), tf_buffer_(tf_cache_time) {
+
+    loadConfig(config);
+}
+
+YAML::Node PointCloudProc::loadConfig(const std::string &config) {
 
     std::string config_path;
     if(config.empty()){
       std::string pkg_path = ros::package::getPath("point_cloud_proc");
       config_path = pkg_path + "/config/default.yaml";
-      std::cout << "PCP: config file : " + config_path << std::endl;
+      ROS_INFO("PCP: config file : %s", config_path.c_str());
     }else{
       config_path = config;
     }
@@ -19,152 +70,467 @@ PointCloudProc::PointCloudProc(ros::NodeHandle n, bool debug, std::string config
     // General parameters
     point_cloud_topic_ = parameters["point_cloud_topic"].as<std::string>();
     fixed_frame_ = parameters["fixed_frame"].as<std::string>();
+    tf_timeout_ = parameters["tf_timeout"].as<double>(0.5);
+    frame_max_age_ = ros::Duration(parameters["frame_max_age_ms"].as<double>(0.0) / 1000.0);
+    frame_timeout_ = ros::Duration(parameters["frame_timeout"].as<double>(0.0));
+    streaming_normals_ = parameters["streaming_normals"].as<bool>(false);
+    streaming_drop_spot_ = parameters["streaming_drop_spot"].as<bool>(false);
+    pipeline_queue_size_ = parameters["pipeline_queue_size"].as<int>(2);
+    stage_stats_.setEnabled(parameters["instrumentation"].as<bool>(false));
 
     // Segmentation parameters
-    eps_angle_ = parameters["segmentation"]["sac_eps_angle"].as<float>();
+    params_.eps_angle = parameters["segmentation"]["sac_eps_angle"].as<float>();
     single_dist_thresh_ = parameters["segmentation"]["sac_dist_thresh_single"].as<float>();
     multi_dist_thresh_ = parameters["segmentation"]["sac_dist_thresh_multi"].as<float>();
-    min_plane_size_ = parameters["segmentation"]["sac_min_plane_size"].as<int>();
-    max_iter_ = parameters["segmentation"]["sac_max_iter"].as<int>();
-    k_search_ = parameters["segmentation"]["ne_k_search"].as<int>();
-    cluster_tol_ = parameters["segmentation"]["ec_cluster_tol"].as<float>();
-    min_cluster_size_ = parameters["segmentation"]["ec_min_cluster_size"].as<int>();
-    max_cluster_size_ = parameters["segmentation"]["ec_max_cluster_size"].as<int>();
+    params_.min_plane_size = parameters["segmentation"]["sac_min_plane_size"].as<int>();
+    params_.max_iter = parameters["segmentation"]["sac_max_iter"].as<int>();
+    params_.parallel_sac = parameters["segmentation"]["sac_method"].as<std::string>("pcl") == "parallel";
+    params_.sac_threads = parameters["segmentation"]["sac_threads"].as<int>(0);
+    params_.sac_seed = parameters["segmentation"]["sac_seed"].as<unsigned int>(0);
+    params_.sac_probability = parameters["segmentation"]["sac_probability"].as<double>(0.99);
+    plane_tracking_ = parameters["segmentation"]["plane_tracking"].as<bool>(false);
+    plane_tracker_.setMinInlierRatio(parameters["segmentation"]["plane_tracking_min_ratio"].as<float>(0.8f));
+    organized_planes_ = parameters["segmentation"]["organized_planes"].as<bool>(false);
+    params_.ne_max_depth_change = parameters["segmentation"]["ne_max_depth_change"].as<float>(0.02f);
+    params_.ne_smoothing_size = parameters["segmentation"]["ne_smoothing_size"].as<float>(10.0f);
+    params_.k_search = parameters["segmentation"]["ne_k_search"].as<int>();
+    params_.ne_threads = parameters["segmentation"]["ne_threads"].as<int>(0);
+    normal_engine_.setNumberOfThreads(params_.ne_threads);
+    params_.cluster_tol = parameters["segmentation"]["ec_cluster_tol"].as<float>();
+    params_.min_cluster_size = parameters["segmentation"]["ec_min_cluster_size"].as<int>();
+    cluster_threads_ = parameters["segmentation"]["ec_threads"].as<int>(0);
+    std::string cluster_method = parameters["segmentation"]["ec_method"].as<std::string>("kdtree");
+    if (!point_cloud_proc::clusterMethodFromString(cluster_method, params_.cluster_method)) {
+        ROS_WARN("PCP: unknown ec_method %s, using kdtree", cluster_method.c_str());
+        params_.cluster_method = point_cloud_proc::CLUSTER_KDTREE;
+    }
+    std::string diameter_method = parameters["segmentation"]["diameter_method"].as<std::string>("pcl");
+    if (!point_cloud_proc::diameterMethodFromString(diameter_method, params_.diameter_method)) {
+        ROS_WARN("PCP: unknown diameter_method %s, using pcl", diameter_method.c_str());
+        params_.diameter_method = point_cloud_proc::DIAMETER_PCL;
+    }
+    params_.diameter_max_error = parameters["segmentation"]["diameter_max_error"].as<float>(0.01f);
+    params_.max_cluster_size = parameters["segmentation"]["ec_max_cluster_size"].as<int>();
+    params_.organized_min_cluster_size = parameters["segmentation"]["organized_min_cluster_size"].as<int>(500);
+    params_.organized_max_cluster_size = parameters["segmentation"]["organized_max_cluster_size"].as<int>(300000);
 
     // Filter parameters
-    leaf_size_ = parameters["filters"]["leaf_size"].as<float>();
-    pass_limits_ = parameters["filters"]["pass_limits"].as<std::vector<float>>();
-    prism_limits_ = parameters["filters"]["prism_limits"].as<std::vector<float>>();
+    params_.leaf_size = parameters["filters"]["leaf_size"].as<float>();
+    fused_front_end_ = parameters["filters"]["fused_front_end"].as<bool>(false);
+    params_.hash_voxel_grid = parameters["filters"]["voxel_method"].as<std::string>("pcl") == "hash";
+    std::string voxel_mode = parameters["filters"]["voxel_mode"].as<std::string>("color_average");
+    if (!point_cloud_proc::voxelModeFromString(voxel_mode, params_.voxel_mode)) {
+        ROS_WARN("PCP: unknown voxel_mode %s, using color_average", voxel_mode.c_str());
+        params_.voxel_mode = point_cloud_proc::VOXEL_COLOR_AVERAGE;
+    }
+    plane_tracker_.setDistanceThreshold(single_dist_thresh_);
+    plane_tracker_.setHullTolerance(2.0f * params_.leaf_size);
+    plane_tracker_.setEpsAngle(params_.eps_angle * (M_PI / 180.0f));
+    params_.pass_limits = parameters["filters"]["pass_limits"].as<std::vector<float>>();
+    params_.prism_limits = parameters["filters"]["prism_limits"].as<std::vector<float>>();
+    params_.monotone_hull = parameters["filters"]["hull_method"].as<std::string>("pcl") == "monotone";
     min_neighbors_ = parameters["filters"]["outlier_min_neighbors"].as<int>();
     radius_search_ = parameters["filters"]["outlier_radius_search"].as<float>();
 
-    point_cloud_sub_ = nh_.subscribe(point_cloud_topic_, 10, &PointCloudProc::pointCloudCb, this);
+    last_frame_.reset(new FrameContext);
 
-    if (debug_) {
-        plane_cloud_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("plane_cloud", 10, true);
-        debug_cloud_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("debug_cloud", 10, true);
-        tabletop_pub_ = nh_.advertise<sensor_msgs::PointCloud2>("tabletop_cloud", 10, true);
-        object_poses_pub_ = nh_.advertise<geometry_msgs::PoseArray>("object_poses", 10, true);
-        point_pub_  = nh_.advertise<geometry_msgs::PointStamped>("object_points", 10, true);
+    return parameters;
+}
+
+PointCloudProc::~PointCloudProc() {
+    stopStreaming();
+}
+
+PointCloudProc::WorkspaceLease::WorkspaceLease(PointCloudProc &pcp) :
+        pcp(pcp) {
+    {
+        boost::mutex::scoped_lock lock(pcp.workspace_mutex_);
+        if (!pcp.workspaces_.empty()) {
+            workspace = pcp.workspaces_.back();
+            pcp.workspaces_.pop_back();
+            return;
+        }
     }
+    workspace.reset(new Workspace(pcp.params_, &pcp.stage_stats_));
+    pcp.configureWorkspace(*workspace);
+}
+
+PointCloudProc::WorkspaceLease::~WorkspaceLease() {
+    // The filters let go of the intermediate clouds before the arena takes
+    // them back, otherwise they would look shared on the next call
+    workspace->segmenter.releaseInputs();
+    workspace->extract.setInputCloud(CloudT::ConstPtr());
+    workspace->outrem.setInputCloud(CloudT::ConstPtr());
+    workspace->plane_proj.setInputCloud(CloudT::ConstPtr());
+    workspace->arena.reset();
+    pcp.scratch_allocations_ += workspace->arena.takeAllocations();
+    boost::mutex::scoped_lock lock(pcp.workspace_mutex_);
+    pcp.workspaces_.push_back(workspace);
+}
+
+void PointCloudProc::configureWorkspace(Workspace &ws) const {
+    ws.mesh_normal_engine.setNumberOfThreads(params_.ne_threads);
+}
+
+FrameContext::Ptr PointCloudProc::newFrame() {
+    boost::mutex::scoped_lock lock(frame_pool_mutex_);
+    for (const FrameContext::Ptr &frame : frame_pool_) {
+        if (frame.unique()) {
+            scratch_allocations_ += frame->recycle();
+            return frame;
+        }
+    }
+    FrameContext::Ptr frame(new FrameContext);
+    frame_pool_.push_back(frame);
+    scratch_allocations_++;
+    return frame;
+}
+
+FrameContext::Ptr PointCloudProc::copyLastFrame() {
+    FrameContext::Ptr frame = newFrame();
+    *frame = *lastFrame();
+    return frame;
+}
+
+FrameContext::Ptr PointCloudProc::lastFrame() {
+    boost::mutex::scoped_lock lock(frame_mutex_);
+    return last_frame_;
+}
+
+void PointCloudProc::setLastFrame(const FrameContext::Ptr &frame) {
+    boost::mutex::scoped_lock lock(frame_mutex_);
+    last_frame_ = frame;
 }
 
 
 void PointCloudProc::pointCloudCb(const sensor_msgs::PointCloud2ConstPtr &msg) {
+    {
+        boost::mutex::scoped_lock lock(pc_mutex_);
+        if (frame_seq_ > 0 && consumed_seq_ != frame_seq_) {
+            frame_stats_.dropped++;
+        }
+        cloud_raw_ros_ = msg;
+        frame_seq_++;
+        frame_stats_.received++;
+    }
+    pc_cond_.notify_all();
+}
+
+void PointCloudProc::setTransform(const geometry_msgs::TransformStamped &transform, bool is_static) {
+    tf_buffer_.setTransform(transform, "point_cloud_proc", is_static);
+}
+
+bool PointCloudProc::waitForCloud(const ros::Time &newer_than, const ros::Duration &timeout) {
     boost::mutex::scoped_lock lock(pc_mutex_);
-    cloud_raw_ros_ = *msg;
-    pc_received_ = true;
+    return waitForCloud(lock, 0, newer_than, timeout);
 }
 
+bool PointCloudProc::waitForCloud(boost::mutex::scoped_lock &lock, uint64_t after_seq,
+                                  const ros::Time &newer_than, const ros::Duration &timeout) {
 
-bool PointCloudProc::transformPointCloud() {
-    pc_received_ = false;
-    ROS_INFO("Waiting for point cloud");
-    while (ros::ok()){
-        if(pc_received_)
-            break;
-        else
-            ros::Duration(0.1).sleep();
+    boost::system_time deadline(boost::posix_time::pos_infin);
+    if (timeout > ros::Duration(0)) {
+        deadline = boost::get_system_time() + boost::posix_time::microseconds(timeout.toNSec() / 1000);
     }
-    ROS_INFO("Received point cloud");
 
+    while (frame_seq_ <= after_seq ||
+           (!newer_than.isZero() && cloud_raw_ros_->header.stamp <= newer_than)) {
+        // stopStreaming() wakes every waiter so the stage threads can be joined
+        if (!ros::ok() || streaming_stop_) {
+            return false;
+        }
+        // Wake up now and then to notice a shutdown, new frames notify right away
+        boost::system_time wake_up = std::min(deadline,
+                boost::get_system_time() + boost::posix_time::milliseconds(100));
+        pc_cond_.timed_wait(lock, wake_up);
+        if (boost::get_system_time() >= deadline) {
+            return frame_seq_ > after_seq &&
+                   (newer_than.isZero() || cloud_raw_ros_->header.stamp > newer_than);
+        }
+    }
+    return true;
+}
+
+
+bool PointCloudProc::acquireFrame(FrameContext &frame) {
     boost::mutex::scoped_lock lock(pc_mutex_);
 
-    cloud_transformed_->clear();
+    // Offline there is no other frame to wait for
+    if (offline_ && frame_seq_ == 0) {
+        ROS_ERROR("PCP: no point cloud handed in");
+        return false;
+    }
+    bool fresh = frame_seq_ > 0 &&
+                 (offline_ ||
+                  (frame_max_age_ > ros::Duration(0) &&
+                   ros::Time::now() - cloud_raw_ros_->header.stamp <= frame_max_age_));
+
+    if (!fresh) {
+        ROS_INFO("Waiting for point cloud");
+        if (!waitForCloud(lock, frame_seq_, ros::Time(0), frame_timeout_)) {
+            ROS_ERROR("PCP: no point cloud received on %s", point_cloud_topic_.c_str());
+            return false;
+        }
+        ROS_INFO("Received point cloud");
+    }
+
+    takeFrame(lock, frame);
+    return true;
+}
 
-    tf2_ros::Buffer tfBuffer;
-    tf2_ros::TransformListener listener(tfBuffer);
-    std::string target_frame = cloud_raw_ros_.header.frame_id;
+void PointCloudProc::takeFrame(boost::mutex::scoped_lock &lock, FrameContext &frame) {
 
-    tfBuffer.canTransform(fixed_frame_, target_frame, ros::Time(0), ros::Duration(2.0));
-    // geometry_msgs::TransformStamped transformStamped;
-    // tf2::Transform cloud_transform;
+    frame.cloud_raw = cloud_raw_ros_;
+    frame.start = ros::WallTime::now();
+    if (consumed_seq_ != frame_seq_) {
+        consumed_seq_ = frame_seq_;
+        frame_stats_.consumed++;
+    }
+    FrameStats frame_stats = frame_stats_;
+    lock.unlock();
 
-    try {
-        // transformStamped = tfBuffer.lookupTransform(fixed_frame_, target_frame, ros::Time(0));
-        // tf2::Stamped<tf2::Transform> transform;
-        // tf2::fromMsg(transformStamped, transform);
-        // cloud_transform.setOrigin(transform.getOrigin());
-        // cloud_transform.setRotation(transform.getRotation());
+    ROS_DEBUG("PCP: frames consumed: %lu dropped: %lu", static_cast<unsigned long>(frame_stats.consumed),
+              static_cast<unsigned long>(frame_stats.dropped));
+}
 
-        CloudT cloud_in;
-        auto time = ros::Time(0);
-        tfBuffer.canTransform(fixed_frame_, target_frame, time, ros::Duration(2.0));
-        pcl::fromROSMsg(cloud_raw_ros_, cloud_in);
-        pcl_ros::transformPointCloud(fixed_frame_, time, cloud_in, target_frame, *cloud_transformed_, tfBuffer);
+bool PointCloudProc::transformStage(FrameContext &frame) {
 
-        // pcl::fromROSMsg(cloud_transformed, *cloud_transformed_);
+    ros::WallTime start = ros::WallTime::now();
+    point_cloud_proc::ScopedStageTimer timer(stage_stats_, point_cloud_proc::STATS_TRANSFORM,
+                                             frame.cloud_raw->width * frame.cloud_raw->height);
 
-        std::cout << "PCP: point cloud is transformed!" << std::endl;
-        return true;
+    frame.cloud_sensor->clear();
+    frame.cloud_transformed->clear();
+    if (!lookupCloudTransform(frame.cloud_raw->header, frame.transform)) {
+        return false;
+    }
+
+    // The fused front end filters straight from the message, the full
+    // resolution clouds of the frame are then only made on demand by
+    // ensureTransformedCloud()
+    if (!fused_front_end_) {
+        pcl::fromROSMsg(*frame.cloud_raw, *frame.cloud_sensor);
+        point_cloud_proc::transformCropPointCloud(*frame.cloud_sensor, frame.transform, params_.pass_limits,
+                                                  *frame.cloud_transformed, frame.inside_limits);
+        frame.cloud_transformed->header.frame_id = fixed_frame_;
+        timer.setPointsOut(frame.cloud_transformed->points.size());
+    }
+
+    ros::WallDuration latency = ros::WallTime::now() - start;
+    {
+        boost::mutex::scoped_lock lock(tf_mutex_);
+        transform_latency_ = latency;
+    }
+    ROS_DEBUG("PCP: point cloud is transformed in %.2f ms", latency.toSec() * 1000.0);
+    return true;
+}
+
+bool PointCloudProc::filterStage(FrameContext &frame) {
+
+    WorkspaceLease ws(*this);
+    return filterFrame(frame, *ws);
+}
 
+bool PointCloudProc::filterFrame(FrameContext &frame, Workspace &ws) {
+
+    if (!fused_front_end_) {
+        return filterTransformedCloud(frame, ws);
     }
-    catch (tf2::TransformException ex) {
-        ROS_ERROR("%s", ex.what());
+
+    ros::WallTime start = ros::WallTime::now();
+    if (!ws.segmenter.fusedFilter(*frame.cloud_raw, frame.transform, *frame.cloud_filtered)) {
+        ROS_WARN("PCP: point cloud is empty after filtering!");
         return false;
     }
+    pcl_conversions::toPCL(frame.cloud_raw->header, frame.cloud_filtered->header);
+    frame.cloud_filtered->header.frame_id = fixed_frame_;
+
+    ROS_DEBUG("PCP: point cloud is filtered in %.2f ms", (ros::WallTime::now() - start).toSec() * 1000.0);
+    return true;
+}
+
+bool PointCloudProc::transformPointCloud() {
+
+    FrameContext::Ptr frame = newFrame();
+    bool transformed = transformFrame(*frame);
+    setLastFrame(frame);
+    return transformed;
+}
 
+bool PointCloudProc::transformAndFilterPointCloud() {
 
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    bool filtered = transformAndFilterFrame(*frame, *ws);
+    setLastFrame(frame);
+    return filtered;
+}
+
+bool PointCloudProc::transformFrame(FrameContext &frame) {
+
+    return acquireFrame(frame) && transformStage(frame) && ensureTransformedCloud(frame);
+}
+
+bool PointCloudProc::transformAndFilterFrame(FrameContext &frame, Workspace &ws) {
+
+    if (!acquireFrame(frame) || !transformStage(frame)) {
+        ROS_WARN("PCP: couldn't transform point cloud!");
+        return false;
+    }
+    if (!filterFrame(frame, ws)) {
+        ROS_WARN("PCP: couldn't filter point cloud!");
+        return false;
+    }
+    return true;
+}
+
+bool PointCloudProc::ensureTransformedCloud(FrameContext &frame) {
+
+    if (!frame.cloud_transformed->empty()) {
+        return true;
+    }
+    if (!frame.cloud_raw) {
+        return false;
+    }
+    point_cloud_proc::ScopedStageTimer timer(stage_stats_, point_cloud_proc::STATS_TRANSFORM,
+                                             frame.cloud_raw->width * frame.cloud_raw->height);
+    pcl::fromROSMsg(*frame.cloud_raw, *frame.cloud_sensor);
+    point_cloud_proc::transformCropPointCloud(*frame.cloud_sensor, frame.transform, params_.pass_limits,
+                                              *frame.cloud_transformed, frame.inside_limits);
+    frame.cloud_transformed->header.frame_id = fixed_frame_;
+    timer.setPointsOut(frame.cloud_transformed->points.size());
+    return true;
+}
+
+bool PointCloudProc::lookupCloudTransform(const std_msgs::Header &header, Eigen::Affine3f &transform) {
+
+    const std::string &source_frame = header.frame_id;
+
+    // Clouds are transformed at their own stamp, a frame that is processed by
+    // several calls in a row only hits the buffer once.
+    geometry_msgs::TransformStamped transform_stamped;
+    bool cached;
+    {
+        boost::mutex::scoped_lock lock(tf_mutex_);
+        cached = source_frame == cached_source_frame_ && cached_transform_.header.stamp == header.stamp;
+        transform_stamped = cached_transform_;
+    }
+    if (!cached) {
+        try {
+            // Nothing fills the buffer of an offline instance in the meantime,
+            // tf2_ros only allows waiting with a listener thread
+            if (offline_) {
+                transform_stamped = tf_buffer_.tf2::BufferCore::lookupTransform(fixed_frame_, source_frame,
+                                                                                header.stamp);
+            } else {
+                transform_stamped = tf_buffer_.lookupTransform(fixed_frame_, source_frame, header.stamp,
+                                                               ros::Duration(tf_timeout_));
+            }
+        }
+        catch (tf2::TransformException &ex) {
+            ROS_ERROR("%s", ex.what());
+            return false;
+        }
+        boost::mutex::scoped_lock lock(tf_mutex_);
+        cached_transform_ = transform_stamped;
+        cached_source_frame_ = source_frame;
+    }
+
+    const geometry_msgs::Transform &t = transform_stamped.transform;
+    transform = Eigen::Translation3f(t.translation.x, t.translation.y, t.translation.z) *
+                Eigen::Quaternionf(t.rotation.w, t.rotation.x, t.rotation.y, t.rotation.z);
+
+    return true;
 }
 
 bool PointCloudProc::filterPointCloud() {
 
-    // Remove part of the scene to leave table and objects alone
+    // Filters a copy of the last frame, the clouds it shares with it are only
+    // read
+    FrameContext::Ptr frame = copyLastFrame();
+    scratch_allocations_ += point_cloud_proc::recycle(frame->cloud_filtered);
+    WorkspaceLease ws(*this);
+    bool filtered = filterTransformedCloud(*frame, *ws);
+    setLastFrame(frame);
+    return filtered;
+}
+
+bool PointCloudProc::filterTransformedCloud(FrameContext &frame, Workspace &ws) {
+
+    // Remove part of the scene to leave table and objects alone. The crop
+    // test normally ran with the transform, a cloud transformed elsewhere is
+    // tested here.
+    bool cropped;
+    if (frame.inside_limits.size() == frame.cloud_transformed->points.size()) {
+        cropped = ws.segmenter.crop(*frame.cloud_transformed, frame.inside_limits, *frame.cloud_filtered);
+    } else {
+        cropped = ws.segmenter.crop(*frame.cloud_transformed, *frame.cloud_filtered);
+    }
 
-    pass_.setInputCloud(cloud_transformed_);
-    pass_.setFilterFieldName("x");
-    pass_.setFilterLimits(pass_limits_[0], pass_limits_[1]);
-    pass_.filter(*cloud_filtered_);
-    pass_.setInputCloud(cloud_filtered_);
-    pass_.setFilterFieldName("y");
-    pass_.setFilterLimits(pass_limits_[2], pass_limits_[3]);
-    pass_.filter(*cloud_filtered_);
-    pass_.setInputCloud(cloud_filtered_);
-    pass_.setFilterFieldName("z");
-    pass_.setFilterLimits(pass_limits_[4], pass_limits_[5]);
-    pass_.filter(*cloud_filtered_);
-
-    std::cout << "PCP: point cloud is filtered!" << std::endl;
-    if (cloud_filtered_->points.size() == 0) {
-        std::cout << "PCP: point cloud is empty after filtering!" << std::endl;
+    ROS_DEBUG("PCP: point cloud is filtered!");
+    if (!cropped) {
+        ROS_WARN("PCP: point cloud is empty after filtering!");
         return false;
     }
 
     // Downsample point cloud
-    vg_.setInputCloud (cloud_filtered_);
-    vg_.setLeafSize (leaf_size_, leaf_size_, leaf_size_);
-    vg_.filter (*cloud_filtered_);
+    ws.segmenter.downsample(frame.cloud_filtered, *frame.cloud_filtered);
 
     return true;
 }
 
 bool PointCloudProc::removeOutliers(CloudT::Ptr in, CloudT::Ptr out) {
 
-    outrem_.setInputCloud(in);
-    outrem_.setRadiusSearch(radius_search_);
-    outrem_.setMinNeighborsInRadius(min_neighbors_);
-    outrem_.filter(*out);
+    WorkspaceLease ws(*this);
+    return removeOutliers(in, out, *ws);
+}
+
+bool PointCloudProc::removeOutliers(const CloudT::Ptr &in, const CloudT::Ptr &out, Workspace &ws) {
 
+    ws.outrem.setInputCloud(in);
+    ws.outrem.setRadiusSearch(radius_search_);
+    ws.outrem.setMinNeighborsInRadius(min_neighbors_);
+    ws.outrem.filter(*out);
+    return !out->empty();
 }
 
 bool PointCloudProc::segmentSinglePlane(point_cloud_proc::Plane &plane, char axis) {
-//    boost::mutex::scoped_lock lock(pc_mutex_);
-    std::cout << "PCP: segmenting single plane..." << std::endl;
 
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
-        return false;
+    // The worker segments the z axis plane of every frame
+    if (streaming_ && axis == 'z') {
+        PipelineSnapshot::ConstPtr snapshot = currentSnapshot();
+        if (!snapshot) {
+            return false;
+        }
+        plane = snapshot->plane;
+        return snapshot->plane_found;
     }
 
-    if (!filterPointCloud()) {
-        std::cout << "PCP: couldn't filter point cloud!" << std::endl;
-        return false;
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    bool found = transformAndFilterFrame(*frame, *ws) && segmentPlane(*frame, axis, *ws);
+    if (found) {
+        plane = std::move(frame->plane);
     }
+    setLastFrame(frame);
+    return found;
+}
 
+bool PointCloudProc::segmentStage(FrameContext &frame, char axis) {
 
-    CloudT::Ptr cloud_plane(new CloudT);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+    WorkspaceLease ws(*this);
+    return segmentPlane(frame, axis, *ws);
+}
+
+bool PointCloudProc::segmentPlane(FrameContext &frame, char axis, Workspace &ws) {
+
+    ROS_DEBUG("PCP: segmenting single plane...");
+
+    point_cloud_proc::Plane &plane = frame.plane;
+    plane = point_cloud_proc::Plane();
+
+    pcl::ModelCoefficients::Ptr coefficients = ws.arena.coefficients();
+    pcl::PointIndices::Ptr inliers = ws.arena.indices();
 
     Eigen::Vector3f axis_vector = Eigen::Vector3f(0.0, 0.0, 0.0);
 
@@ -176,55 +542,82 @@ bool PointCloudProc::segmentSinglePlane(point_cloud_proc::Plane &plane, char axi
         axis_vector[2] = 1.0;
     }
 
-    seg_.setOptimizeCoefficients(true);
-    seg_.setMaxIterations(max_iter_);
-    seg_.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
-    // seg_.setModelType(pcl::SACMODEL_PLANE);
-    seg_.setMethodType(pcl::SAC_RANSAC);
-    seg_.setAxis(axis_vector);
-    seg_.setEpsAngle(eps_angle_ * (M_PI / 180.0f));
-    seg_.setDistanceThreshold(single_dist_thresh_);
-    seg_.setInputCloud(cloud_filtered_);
-    seg_.segment(*inliers, *coefficients);
-
+    // The plane of the last call is checked first, RANSAC only runs when it
+    // does not fit anymore. Only the copy of the tracker is made under the
+    // lock, the scan runs outside it. Concurrent calls race for the tracked
+    // plane, the last update wins.
+    bool tracked = false, hull_tracked = false;
+    point_cloud_proc::PlaneTracker tracker;
+    if (plane_tracking_) {
+        {
+            boost::mutex::scoped_lock lock(tracker_mutex_);
+            tracker = plane_tracker_;
+        }
+        tracked = tracker.track(*frame.cloud_filtered, axis_vector, *inliers, *coefficients);
+        hull_tracked = tracked && tracker.hullValid();
+        if (hull_tracked) {
+            *frame.cloud_hull = tracker.getHull();
+        }
+    }
+    if (!tracked) {
+        ws.segmenter.fitPlane(frame.cloud_filtered, pcl::PointIndices::Ptr(), single_dist_thresh_, axis_vector,
+                              *inliers, *coefficients);
+    }
 
     if (inliers->indices.size() == 0) {
-        std::cout << "PCP: plane is empty!" << std::endl;
+        ROS_WARN("PCP: plane is empty!");
+        boost::mutex::scoped_lock lock(tracker_mutex_);
+        plane_tracker_.reset();
         return false;
     }
 
-    extract_.setInputCloud(cloud_filtered_);
-    extract_.setNegative(false);
-    extract_.setIndices(inliers);
-    extract_.filter(*cloud_plane);
+    // The plane stays a view of cloud_filtered, its points are only copied
+    // into the message
+    point_cloud_proc::CloudView plane_view(*frame.cloud_filtered, &inliers->indices);
+    ROS_DEBUG("PCP: # of points in plane: %zu", plane_view.size());
 
-    if (debug_) {
-        std::cout << "PCP: # of points in plane: " << cloud_plane->points.size() << std::endl;
-        plane_cloud_pub_.publish(cloud_plane);
+    if (hull_tracked) {
+        frame.cloud_hull->header = frame.cloud_filtered->header;
+    } else {
+        frame.cloud_hull->clear();
+        ws.segmenter.computeHull(frame.cloud_filtered, &inliers->indices, *coefficients, *frame.cloud_hull);
+        if (tracked) {
+            // Only the hull moved, the tracked plane keeps the inlier count
+            // of the RANSAC plane it is compared against
+            tracker.updateHull(*frame.cloud_filtered, inliers->indices, *frame.cloud_hull);
+        } else if (plane_tracking_) {
+            boost::mutex::scoped_lock lock(tracker_mutex_);
+            plane_tracker_.update(*frame.cloud_filtered, inliers->indices, *coefficients, axis_vector, *frame.cloud_hull);
+        }
+    }
+    if (tracked) {
+        boost::mutex::scoped_lock lock(tracker_mutex_);
+        plane_tracker_.accept(tracker);
     }
 
-    cloud_hull_->clear();
-    chull_.setInputCloud(cloud_plane);
-    chull_.setDimension(2);
-    chull_.reconstruct(*cloud_hull_);
+    ROS_DEBUG("PCP: plane %s", tracked ? "tracked" : "segmented");
 
     // Get cloud
-    pcl::toROSMsg(*cloud_plane, plane.cloud);
+    {
+        point_cloud_proc::ScopedStageTimer timer(stage_stats_, point_cloud_proc::STATS_SERIALIZATION,
+                                                 plane_view.size());
+        toROSMsg(plane_view, plane.cloud);
+        timer.setPointsOut(plane_view.size());
+    }
+    if (debug_) {
+        plane_cloud_pub_.publish(plane.cloud);
+    }
 
     // Construct plane object msg
-    pcl_conversions::fromPCL(cloud_plane->header, plane.header);
+    pcl_conversions::fromPCL(frame.cloud_filtered->header, plane.header);
 
-    // Get plane center
-    Eigen::Vector4f center;
-    pcl::compute3DCentroid(*cloud_plane, center);
+    // Get plane center, min and max values
+    Eigen::Vector3f center, min_vals, max_vals;
+    point_cloud_proc::computeBounds(plane_view, center, min_vals, max_vals);
     plane.center.x = center[0];
     plane.center.y = center[1];
     plane.center.z = center[2];
 
-    // Get plane min and max values
-    Eigen::Vector4f min_vals, max_vals;
-    pcl::getMinMax3D(*cloud_plane, min_vals, max_vals);
-
     plane.min.x = min_vals[0];
     plane.min.y = min_vals[1];
     plane.min.z = min_vals[2];
@@ -235,11 +628,11 @@ bool PointCloudProc::segmentSinglePlane(point_cloud_proc::Plane &plane, char axi
     plane.max.z = max_vals[2];
 
     // Get plane polygon
-    for (int i = 0; i < cloud_hull_->points.size(); i++) {
+    for (int i = 0; i < frame.cloud_hull->points.size(); i++) {
         geometry_msgs::Point32 p;
-        p.x = cloud_hull_->points[i].x;
-        p.y = cloud_hull_->points[i].y;
-        p.z = cloud_hull_->points[i].z;
+        p.x = frame.cloud_hull->points[i].x;
+        p.y = frame.cloud_hull->points[i].y;
+        p.z = frame.cloud_hull->points[i].z;
 
         plane.polygon.push_back(p);
     }
@@ -250,7 +643,7 @@ bool PointCloudProc::segmentSinglePlane(point_cloud_proc::Plane &plane, char axi
     plane.coef[2] = coefficients->values[2];
     plane.coef[3] = coefficients->values[3];
 
-    plane.size.data = cloud_plane->points.size();
+    plane.size.data = plane_view.size();
 
 //    extract_.setNegative(true);
 //    extract_.filter(*cloud_filtered_);
@@ -260,375 +653,442 @@ bool PointCloudProc::segmentSinglePlane(point_cloud_proc::Plane &plane, char axi
 
 bool PointCloudProc::segmentMultiplePlane(std::vector<point_cloud_proc::Plane> &planes) {
 
-//    boost::mutex::scoped_lock lock(pc_mutex_);
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    bool found = segmentPlanes(*frame, planes, *ws);
+    setLastFrame(frame);
+    return found;
+}
 
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
-        return false;
-    }
+bool PointCloudProc::segmentPlanes(FrameContext &frame, std::vector<point_cloud_proc::Plane> &planes, Workspace &ws) {
 
-    if (!filterPointCloud()) {
-        std::cout << "PCP: couldn't filter point cloud!" << std::endl;
+    if (organized_planes_) {
+        if (!transformFrame(frame)) {
+            ROS_WARN("PCP: couldn't transform point cloud!");
+            return false;
+        }
+        if (frame.cloud_sensor->isOrganized()) {
+            return segmentOrganizedPlanes(frame, planes, ws);
+        }
+        if (!filterTransformedCloud(frame, ws)) {
+            ROS_WARN("PCP: couldn't filter point cloud!");
+            return false;
+        }
+    } else if (!transformAndFilterFrame(frame, ws)) {
         return false;
     }
 
     CloudT plane_clouds;
-    plane_clouds.header.frame_id = cloud_transformed_->header.frame_id;
-    point_cloud_proc::Plane plane_object_msg;
-
-    int no_planes = 1;
-    CloudT::Ptr cloud_plane_raw(new CloudT);
-    CloudT::Ptr cloud_plane(new CloudT);
-    CloudT::Ptr cloud_hull(new CloudT);
+    plane_clouds.header.frame_id = frame.cloud_filtered->header.frame_id;
 
-//    Eigen::Vector3f axis = Eigen::Vector3f(0.0,0.0,1.0); //z axis
-//    seg_.setModelType (pcl::SACMODEL_PERPENDICULAR_PLANE);
-//    seg_.setAxis(axis);
+    std::vector<pcl::PointIndices> inliers;
+    std::vector<pcl::ModelCoefficients> coefficients;
+    pcl::PointIndices::Ptr remaining = ws.arena.indices();
+    ws.segmenter.fitPlanes(frame.cloud_filtered, multi_dist_thresh_, inliers, coefficients, *remaining);
 
-    seg_.setOptimizeCoefficients(true);
-    seg_.setModelType(pcl::SACMODEL_PLANE);
-    seg_.setMaxIterations(max_iter_);
-    seg_.setMethodType(pcl::SAC_RANSAC);
-    seg_.setEpsAngle(eps_angle_ * (M_PI / 180.0f));
-    seg_.setDistanceThreshold(multi_dist_thresh_);
+    for (size_t i = 0; i < inliers.size(); i++) {
 
-    while (true) {
+        point_cloud_proc::Plane plane_object_msg;
+        std::string axis = fillPlaneMsg(frame.cloud_filtered, inliers[i].indices, coefficients[i],
+                                        plane_object_msg, ws);
+        planes.push_back(plane_object_msg);
 
-        pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-        pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-        seg_.setInputCloud(cloud_filtered_);
-        seg_.segment(*inliers, *coefficients);
+        ROS_DEBUG("PCP: %zu. plane segmented! # of points: %zu axis: %s", planes.size(),
+                  inliers[i].indices.size(), axis.c_str());
 
-        if (inliers->indices.size() == 0 and no_planes == 0) {
-            std::cout << "PCP: no plane found!!!" << std::endl;
-            return false;
-        } else if (inliers->indices.size() < min_plane_size_) {
-            break;
+        if (debug_) {
+            for (int index : inliers[i].indices) {
+                plane_clouds.push_back(frame.cloud_filtered->points[index]);
+            }
         }
+    }
 
+    // cloud_filtered keeps what is left after removing the planes, compacted
+    // in place
+    point_cloud_proc::keepIndices(*frame.cloud_filtered, remaining->indices);
 
-//            std::cout << "PCP: plane coefficients : " << coefficients->values[0]  << " "
-//                                                      << coefficients->values[1]  << " "
-//                                                      << coefficients->values[2]  << " "
-//                                                      << coefficients->values[3]  << std::endl;
-
-
-        extract_.setInputCloud(cloud_filtered_);
-        extract_.setNegative(false);
-        extract_.setIndices(inliers);
-        extract_.filter(*cloud_plane);
+    if (debug_) {
+        plane_cloud_pub_.publish(plane_clouds);
+    }
 
-//        plane_proj_.setInputCloud(cloud_plane_raw);
-//        plane_proj_.setModelType(pcl::SACMODEL_PLANE);
-//        plane_proj_.setModelCoefficients (coefficients);
-//        plane_proj_.filter (*cloud_plane);
+    if (planes.empty()) {
+        ROS_WARN("PCP: no plane found!!!");
+        return false;
+    }
 
+    return true;
+}
 
-//        removeOutliers(cloud_plane_raw, cloud_plane);
+std::string PointCloudProc::fillPlaneMsg(const CloudT::Ptr &cloud,
+                                         const std::vector<int> &inliers,
+                                         const pcl::ModelCoefficients &coefficients,
+                                         point_cloud_proc::Plane &plane,
+                                         Workspace &ws) {
 
-        plane_clouds += *cloud_plane;
+    // Center, bounds and hull are reduced over the inliers in place, the
+    // points are only copied into the message
+    point_cloud_proc::CloudView plane_view(*cloud, &inliers);
+    Eigen::Vector3f center, min_vals, max_vals;
+    point_cloud_proc::computeBounds(plane_view, center, min_vals, max_vals);
 
-        chull_.setInputCloud(cloud_plane);
-        chull_.setDimension(2);
-        chull_.reconstruct(*cloud_hull);
+    CloudT::Ptr cloud_hull = ws.arena.cloud();
+    ws.segmenter.computeHull(cloud, &inliers, coefficients, *cloud_hull);
 
-        Eigen::Vector4f center;
-        pcl::compute3DCentroid(*cloud_hull, center);
+    // Get cloud
+    {
+        point_cloud_proc::ScopedStageTimer timer(stage_stats_, point_cloud_proc::STATS_SERIALIZATION,
+                                                 plane_view.size());
+        toROSMsg(plane_view, plane.cloud);
+        timer.setPointsOut(plane_view.size());
+    }
 
-        Eigen::Vector4f min_vals, max_vals;
-        pcl::getMinMax3D(*cloud_plane, min_vals, max_vals);
+    // Construct plane object msg
+    pcl_conversions::fromPCL(cloud->header, plane.header);
 
-        // Get cloud
-        pcl::toROSMsg(*cloud_plane, plane_object_msg.cloud);
+    // Get plane center
+    plane.center.x = center[0];
+    plane.center.y = center[1];
+    plane.center.z = center[2];
 
-        // Construct plane object msg
-        pcl_conversions::fromPCL(cloud_plane->header, plane_object_msg.header);
+    // Get plane min and max values
+    plane.min.x = min_vals[0];
+    plane.min.y = min_vals[1];
+    plane.min.z = min_vals[2];
 
-        // Get plane center
-        plane_object_msg.center.x = center[0];
-        plane_object_msg.center.y = center[1];
-        plane_object_msg.center.z = center[2];
+    plane.max.x = max_vals[0];
+    plane.max.y = max_vals[1];
+    plane.max.z = max_vals[2];
 
-        // Get plane min and max values
-        plane_object_msg.min.x = min_vals[0];
-        plane_object_msg.min.y = min_vals[1];
-        plane_object_msg.min.z = min_vals[2];
+    // Get plane polygon
+    for (int i = 0; i < cloud_hull->points.size(); i++) {
+        geometry_msgs::Point32 p;
+        p.x = cloud_hull->points[i].x;
+        p.y = cloud_hull->points[i].y;
+        p.z = cloud_hull->points[i].z;
+        plane.polygon.push_back(p);
+    }
 
+    // Get plane coefficients
+    plane.coef[0] = coefficients.values[0];
+    plane.coef[1] = coefficients.values[1];
+    plane.coef[2] = coefficients.values[2];
+    plane.coef[3] = coefficients.values[3];
+
+    plane.size.data = plane_view.size();
+
+    std::string axis;
+
+    if (std::abs(coefficients.values[0]) < 1.1 &&
+        std::abs(coefficients.values[0]) > 0.9 &&
+        std::abs(coefficients.values[1]) < 0.1 &&
+        std::abs(coefficients.values[2]) < 0.1) {
+        plane.orientation = point_cloud_proc::Plane::XAXIS;
+        axis = "X";
+    } else if (std::abs(coefficients.values[0]) < 0.1 &&
+               std::abs(coefficients.values[1]) > 0.9 &&
+               std::abs(coefficients.values[1]) < 1.1 &&
+               std::abs(coefficients.values[2]) < 0.1) {
+        plane.orientation = point_cloud_proc::Plane::YAXIS;
+        axis = "Y";
+    } else if (std::abs(coefficients.values[0]) < 0.1 &&
+               std::abs(coefficients.values[1]) < 0.1 &&
+               std::abs(coefficients.values[2]) < 1.1 &&
+               std::abs(coefficients.values[2]) > 0.9) {
+        plane.orientation = point_cloud_proc::Plane::ZAXIS;
+        axis = "Z";
+    } else {
+        plane.orientation = point_cloud_proc::Plane::NOAXIS;
+        axis = "NO";
+    }
 
-        plane_object_msg.max.x = max_vals[0];
-        plane_object_msg.max.y = max_vals[1];
-        plane_object_msg.max.z = max_vals[2];
+    return axis;
+}
 
-        // Get plane polygon
-        for (int i = 0; i < cloud_hull->points.size(); i++) {
-            geometry_msgs::Point32 p;
-            p.x = cloud_hull->points[i].x;
-            p.y = cloud_hull->points[i].y;
-            p.z = cloud_hull->points[i].z;
-            plane_object_msg.polygon.push_back(p);
-        }
+bool PointCloudProc::segmentOrganizedPlanes(FrameContext &frame, std::vector<point_cloud_proc::Plane> &planes,
+                                            Workspace &ws) {
+
+    std::vector<pcl::PointIndices> inliers;
+    std::vector<pcl::ModelCoefficients> coefficients;
+    bool found = ws.segmenter.fitOrganizedPlanes(*frame.cloud_sensor, *frame.cloud_transformed, frame.transform,
+                                                 multi_dist_thresh_, inliers, coefficients);
+
+    // cloud_filtered keeps the cropped and downsampled points off the
+    // planes, like on the unorganized path
+    pcl::PointIndices::Ptr in_limits = ws.arena.indices(), on_planes = ws.arena.indices();
+    pcl::PointIndices::Ptr remaining = ws.arena.indices();
+    ws.segmenter.cropIndices(*frame.cloud_transformed, *in_limits);
+    for (const pcl::PointIndices &plane_inliers : inliers) {
+        on_planes->indices.insert(on_planes->indices.end(), plane_inliers.indices.begin(),
+                                  plane_inliers.indices.end());
+    }
+    std::sort(on_planes->indices.begin(), on_planes->indices.end());
+    std::set_difference(in_limits->indices.begin(), in_limits->indices.end(), on_planes->indices.begin(),
+                        on_planes->indices.end(), std::back_inserter(remaining->indices));
+    pcl::copyPointCloud(*frame.cloud_transformed, remaining->indices, *frame.cloud_filtered);
+    if (!frame.cloud_filtered->empty()) {
+        ws.segmenter.downsample(frame.cloud_filtered, *frame.cloud_filtered);
+    }
 
-        // Get plane coefficients
-        plane_object_msg.coef[0] = coefficients->values[0];
-        plane_object_msg.coef[1] = coefficients->values[1];
-        plane_object_msg.coef[2] = coefficients->values[2];
-        plane_object_msg.coef[3] = coefficients->values[3];
-
-        std::string axis;
-
-        if (std::abs(coefficients->values[0]) < 1.1 &&
-            std::abs(coefficients->values[0]) > 0.9 &&
-            std::abs(coefficients->values[1]) < 0.1 &&
-            std::abs(coefficients->values[2]) < 0.1) {
-            plane_object_msg.orientation = point_cloud_proc::Plane::XAXIS;
-            axis = "X";
-        } else if (std::abs(coefficients->values[0]) < 0.1 &&
-                   std::abs(coefficients->values[1]) > 0.9 &&
-                   std::abs(coefficients->values[1]) < 1.1 &&
-                   std::abs(coefficients->values[2]) < 0.1) {
-            plane_object_msg.orientation = point_cloud_proc::Plane::YAXIS;
-            axis = "Y";
-        } else if (std::abs(coefficients->values[0]) < 0.1 &&
-                   std::abs(coefficients->values[1]) < 0.1 &&
-                   std::abs(coefficients->values[2]) < 1.1 &&
-                   std::abs(coefficients->values[2]) > 0.9) {
-            plane_object_msg.orientation = point_cloud_proc::Plane::ZAXIS;
-            axis = "Z";
-        } else {
-            plane_object_msg.orientation = point_cloud_proc::Plane::NOAXIS;
-            axis = "NO";
-        }
+    if (!found) {
+        ROS_WARN("PCP: no plane found!!!");
+        return false;
+    }
 
-        std::cout << "PCP: " << no_planes << ". plane segmented! # of points: "
-                  << inliers->indices.size() << " axis: " << axis << std::endl;
-        no_planes++;
+    CloudT plane_clouds;
+    plane_clouds.header.frame_id = frame.cloud_transformed->header.frame_id;
 
-        plane_object_msg.size.data = cloud_plane->points.size();
+    for (size_t i = 0; i < inliers.size(); i++) {
 
+        point_cloud_proc::Plane plane_object_msg;
+        std::string axis = fillPlaneMsg(frame.cloud_transformed, inliers[i].indices, coefficients[i],
+                                        plane_object_msg, ws);
         planes.push_back(plane_object_msg);
-        extract_.setNegative(true);
-        extract_.filter(*cloud_filtered_);
-
+        if (debug_) {
+            for (int index : inliers[i].indices) {
+                plane_clouds.push_back(frame.cloud_transformed->points[index]);
+            }
+        }
 
-        ros::Duration(0.2).sleep();
+        ROS_DEBUG("PCP: %zu. plane segmented! # of points: %zu axis: %s", i + 1,
+                  inliers[i].indices.size(), axis.c_str());
     }
 
     if (debug_) {
         plane_cloud_pub_.publish(plane_clouds);
     }
 
-
     return true;
 }
 
 bool PointCloudProc::extractTabletop() {
 
-    pcl::PointIndices::Ptr tabletop_indices(new pcl::PointIndices);
-    prism_.setInputCloud(cloud_filtered_);
-    prism_.setInputPlanarHull(cloud_hull_);
-    prism_.setHeightLimits(prism_limits_[0], prism_limits_[1]);
-    prism_.segment(*tabletop_indices);
+    // Extracts from a copy of the last frame, the clouds it shares with it
+    // are only read
+    FrameContext::Ptr frame = copyLastFrame();
+    WorkspaceLease ws(*this);
+    bool extracted = extractTabletop(*frame, *ws);
+    setLastFrame(frame);
+    return extracted;
+}
 
-    tabletop_indicies_ = tabletop_indices;
+bool PointCloudProc::extractTabletop(sensor_msgs::PointCloud2 &cloud) {
 
-    extract_.setInputCloud(cloud_filtered_);
-    extract_.setIndices(tabletop_indices);
-    extract_.filter(*cloud_tabletop_);
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    bool extracted = transformAndFilterFrame(*frame, *ws) && segmentPlane(*frame, 'z', *ws) &&
+                     extractTabletop(*frame, *ws);
+    setLastFrame(frame);
 
-    if (cloud_tabletop_->points.size() == 0) {
+    point_cloud_proc::CloudView tabletop(*frame->cloud_filtered, &frame->tabletop_indices->indices);
+    point_cloud_proc::ScopedStageTimer timer(stage_stats_, point_cloud_proc::STATS_SERIALIZATION, tabletop.size());
+    toROSMsg(tabletop, cloud);
+    timer.setPointsOut(tabletop.size());
+    return extracted;
+}
+
+bool PointCloudProc::extractTabletop(FrameContext &frame, Workspace &ws) {
+
+    // A copied frame shares its indices with the frame it was copied from
+    scratch_allocations_ += point_cloud_proc::recycle(frame.tabletop_indices);
+    ws.segmenter.segmentPrism(frame.cloud_filtered, pcl::PointIndices::Ptr(), frame.cloud_hull,
+                              *frame.tabletop_indices);
+
+    // The tabletop stays a view of cloud_filtered
+    if (frame.tabletop_indices->indices.empty()) {
         return false;
     } else {
         if (debug_) {
-            tabletop_pub_.publish(cloud_tabletop_);
+            sensor_msgs::PointCloud2 tabletop;
+            toROSMsg(point_cloud_proc::CloudView(*frame.cloud_filtered, &frame.tabletop_indices->indices), tabletop);
+            tabletop_pub_.publish(tabletop);
         }
         return true;
     }
 }
 
+bool PointCloudProc::clusterStage(FrameContext &frame, bool compute_normals) {
+
+    WorkspaceLease ws(*this);
+    frame.objects.clear();
+    return extractTabletop(frame, *ws) && clusterTabletop(frame, frame.objects, compute_normals, *ws);
+}
+
 bool PointCloudProc::clusterObjects(std::vector<point_cloud_proc::Object> &objects,
                                     bool compute_normals, bool project) {
 
-    geometry_msgs::PoseArray object_poses_rviz;
-    std::cout << "PCP: clustering tabletop objects... " << std::endl;
+    ROS_DEBUG("PCP: clustering tabletop objects...");
 
-    point_cloud_proc::Plane plane;
-    if (!segmentSinglePlane(plane)) {
-        return false;
-    }
-
-    if (!extractTabletop()) {
-        return false;
+    if (streaming_ && (!compute_normals || streaming_normals_)) {
+        PipelineSnapshot::ConstPtr snapshot = currentSnapshot();
+        if (!snapshot) {
+            return false;
+        }
+        objects.insert(objects.end(), snapshot->objects.begin(), snapshot->objects.end());
+        return snapshot->objects_found;
     }
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    coefficients->values.push_back(plane.coef[0]);
-    coefficients->values.push_back(plane.coef[1]);
-    coefficients->values.push_back(plane.coef[2]);
-    coefficients->values.push_back(plane.coef[3]);
 
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    bool found = transformAndFilterFrame(*frame, *ws) && segmentPlane(*frame, 'z', *ws) &&
+                 extractTabletop(*frame, *ws) && clusterTabletop(*frame, objects, compute_normals, *ws);
+    setLastFrame(frame);
+    return found;
+}
 
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGB>);
+bool PointCloudProc::clusterTabletop(FrameContext &frame, std::vector<point_cloud_proc::Object> &objects,
+                                     bool compute_normals, Workspace &ws) {
 
-    tree->setInputCloud(cloud_tabletop_);
+    geometry_msgs::PoseArray object_poses_rviz;
     std::vector<pcl::PointIndices> cloud_clusters;
-
-    ec_.setClusterTolerance(cluster_tol_);
-    ec_.setMinClusterSize(min_cluster_size_);
-    ec_.setMaxClusterSize(max_cluster_size_);
-    ec_.setSearchMethod(tree);
-    ec_.setInputCloud(cloud_tabletop_);
-    ec_.extract(cloud_clusters);
-
-    pcl::PCA<PointT> pca_ = new pcl::PCA<PointT>;
-    pcl::NormalEstimationOMP<PointT, PointNT> ne(4);
-
+    // Clusters are indices of cluster_cloud, the tabletop view of
+    // cloud_filtered unless the organized cloud is clustered
+    CloudT::Ptr cluster_cloud = frame.cloud_filtered;
+    frame.object_pixel_indices.clear();
+
+    if (params_.cluster_method == point_cloud_proc::CLUSTER_ORGANIZED && ensureTransformedCloud(frame) &&
+        frame.cloud_transformed->isOrganized()) {
+        // Tabletop pixels of the full resolution frame, clustered on the
+        // image grid
+        pcl::PointIndices::Ptr in_limits = ws.arena.indices();
+        ws.segmenter.cropIndices(*frame.cloud_transformed, *in_limits);
+
+        pcl::PointIndices tabletop_pixels;
+        ws.segmenter.segmentPrism(frame.cloud_transformed, in_limits, frame.cloud_hull, tabletop_pixels);
+
+        ws.segmenter.clusterOrganized(frame.cloud_transformed, tabletop_pixels.indices, cloud_clusters);
+        cluster_cloud = frame.cloud_transformed;
+        frame.object_pixel_indices = cloud_clusters;
+    } else {
+        ws.segmenter.cluster(frame.cloud_filtered, frame.tabletop_indices, cloud_clusters);
+    }
 
     if (cloud_clusters.size() == 0)
         return false;
     else
-        std::cout << "PCP: number of clusters: " << cloud_clusters.size() << std::endl;
-
-    int k = 0;
-    for (auto cluster_indicies : cloud_clusters) {
-
-        CloudT::Ptr cluster(new CloudT);
-        CloudT::Ptr cluster_projected(new CloudT);
-        CloudNT::Ptr cluster_normals(new CloudNT);
-
-        pcl::PointIndices::Ptr object_indicies_ptr(new pcl::PointIndices);
-        object_indicies_ptr->indices = cluster_indicies.indices;
-
-        extract_.setInputCloud(cloud_tabletop_);
-        extract_.setIndices(object_indicies_ptr);
-        extract_.setNegative(false);
-        extract_.filter(*cluster);
-
-        // Compute PCA to find centeroid and orientation
-//        Eigen::Matrix3f eigen_vectors;
-//        Eigen::Vector3f eigen_values;
-//        Eigen::Vector4f mean_values;
-//        if (project) {
-//            plane_proj_.setModelType(pcl::SACMODEL_PLANE);
-//            plane_proj_.setModelCoefficients(coefficients);
-//            plane_proj_.setInputCloud(cluster);
-//            plane_proj_.filter(*cluster_projected);
-//
-//            pca_.setInputCloud(cluster_projected);
-//            eigen_vectors = pca_.getEigenVectors();
-//
-//            eigen_values = pca_.getEigenValues();
-//            pca_.setInputCloud(cluster);
-//            mean_values = pca_.getMean();
-//
-//            std::cout << "PCP: eigen vectors: " << std::endl << eigen_vectors << std::endl;
-//
-//        } else {
-//            pca_.setInputCloud(cluster);
-//            eigen_vectors = pca_.getEigenVectors();
-//            eigen_values = pca_.getEigenValues();
-//            mean_values = pca_.getMean();
-//        }
-//
-//        Eigen::Quaternionf quat(eigen_vectors);
-//        quat.normalize();
-
-
-        if (compute_normals) {
-            // Compute point normals
-            pcl::search::KdTree<PointT>::Ptr normals_tree(new pcl::search::KdTree<PointT>());
-            ne.setInputCloud(cluster);
-            ne.setSearchMethod(normals_tree);
-            ne.setKSearch(k_search_);
-            ne.compute(*cluster_normals);
-        }
-
-        // Find position
-        Eigen::Vector4f center;
-        pcl::compute3DCentroid(*cluster, center);
-
-        // Find orientetions
-        // Get max segment
-        PointT pmin, pmax;
-        pcl::getMaxSegment(*cluster, pmin, pmax);
-//        double y_axis_norm = std::sqrt(std::pow(pmin.x-pmax.x, 2) + std::pow(pmin.y-pmax.y, 2));
-        Eigen::Vector3d y_axis (pmin.x-pmax.x, pmin.y-pmax.y, 0.0);
-        y_axis.normalize();
-        Eigen::Vector3d z_axis (0.0, 0.0, 1.0);
-        Eigen::Vector3d x_axis = y_axis.cross(z_axis);
-
-        Eigen::Matrix3d rot;
-        rot << x_axis(0), y_axis(0), z_axis(0),
-               x_axis(1), y_axis(1), z_axis(1),
-               x_axis(2), y_axis(2), z_axis(1);
-
-        Eigen::Quaterniond q(rot);
-
-        point_cloud_proc::Object object;
-        // Get object point cloud
-        pcl_conversions::fromPCL(cluster->header, object.header);
-
-        // Get cloud
-        pcl::toROSMsg(*cluster, object.cloud);
-
-        if (compute_normals) {
-            // Get point normals
-            for (int i = 0; i < cluster_normals->points.size(); i++) {
-                geometry_msgs::Vector3 normal;
-                normal.x = cluster_normals->points[i].normal_x;
-                normal.y = cluster_normals->points[i].normal_y;
-                normal.z = cluster_normals->points[i].normal_z;
-                object.normals.push_back(normal);
+        ROS_DEBUG("PCP: number of clusters: %zu", cloud_clusters.size());
+
+    CloudNT::ConstPtr normals;
+    if (compute_normals) {
+        // One search index over the tabletop points, the objects slice their
+        // normals out of it. The organized cloud only needs the clustered
+        // pixels, neighbours are searched among them only.
+        pcl::PointIndices::Ptr clustered = frame.tabletop_indices;
+        if (cluster_cloud != frame.cloud_filtered) {
+            clustered = ws.arena.indices();
+            for (const pcl::PointIndices &cluster : cloud_clusters) {
+                clustered->indices.insert(clustered->indices.end(), cluster.indices.begin(), cluster.indices.end());
             }
+            std::sort(clustered->indices.begin(), clustered->indices.end());
         }
+        // Clouds made from the same message with the same transform hold the
+        // same points, whichever workspace computed their normals
+        point_cloud_proc::NormalSource source(frame.cloud_raw, frame.transform.matrix());
+        boost::mutex::scoped_lock lock(normal_mutex_);
+        normals = ws.segmenter.computeNormals(normal_engine_, cluster_cloud, clustered, source);
+    }
 
+    // Every cluster is written to its own slot so the objects keep the order
+    // of cloud_clusters
+    size_t first = objects.size();
+    objects.resize(first + cloud_clusters.size());
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = cluster_threads_ > 0 ? cluster_threads_ : omp_get_max_threads();
+#endif
+    while (static_cast<int>(ws.cluster_scratch.size()) < threads) {
+        ws.cluster_scratch.push_back(boost::shared_ptr<ClusterScratch>(new ClusterScratch));
+    }
 
-        object.pmin.x = pmin.x;
-        object.pmin.y = pmin.y;
-        object.pmin.z = pmin.z;
-
-        object.pmax.x = pmax.x;
-        object.pmax.y = pmax.y;
-        object.pmax.z = pmax.z;
-
-        // Get object center
-        object.center.x = center[0];
-        object.center.y = center[1];
-        object.center.z = center[2];
-
-        // geometry_msgs::Pose cluster_pose;
-        object.pose.position.x = center[0];
-        object.pose.position.y = center[1];
-        object.pose.position.z = center[2];
+    #pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (int i = 0; i < static_cast<int>(cloud_clusters.size()); i++) {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        computeObject(*cluster_cloud, cloud_clusters[i], normals, ws.segmenter, *ws.cluster_scratch[thread],
+                      objects[first + i]);
+    }
 
+    for (size_t i = 0; i < cloud_clusters.size(); i++) {
+        object_poses_rviz.poses.push_back(objects[first + i].pose);
+        ROS_DEBUG("PCP: # of points in object %zu : %zu", i + 1, cloud_clusters[i].indices.size());
+    }
 
-        object.pose.orientation.x = q.x();
-        object.pose.orientation.y = q.y();
-        object.pose.orientation.z = q.z();
-        object.pose.orientation.w = q.w();
+    if (debug_) {
+        object_poses_rviz.header.frame_id = frame.cloud_filtered->header.frame_id;
+        object_poses_pub_.publish(object_poses_rviz);
+    }
+    return true;
+}
 
-        // Get min max points coords
-        Eigen::Vector4f min_vals, max_vals;
-        pcl::getMinMax3D(*cluster, min_vals, max_vals);
+void PointCloudProc::computeObject(const CloudT &cloud, const pcl::PointIndices &indices,
+                                   const CloudNT::ConstPtr &normals,
+                                   const point_cloud_proc::SceneSegmenter &segmenter, ClusterScratch &scratch,
+                                   point_cloud_proc::Object &object) const {
 
-        object.min.x = min_vals[0];
-        object.min.y = min_vals[1];
-        object.min.z = min_vals[2];
-        object.max.x = max_vals[0];
-        object.max.y = max_vals[1];
-        object.max.z = max_vals[2];
+    CloudT::Ptr &cluster = scratch.cluster;
+    CloudNT::Ptr &cluster_normals = scratch.normals;
+    point_cloud_proc::ObjectGeometry geometry;
+    segmenter.computeObject(cloud, indices, *cluster, geometry);
 
-        object_poses_rviz.poses.push_back(object.pose);
-        k++;
+    if (normals) {
+        point_cloud_proc::sliceNormals(*normals, indices.indices, *cluster_normals);
+    }
 
-        std::cout << "PCP: # of points in object " << k << " : " << cluster->points.size() << std::endl;
+    // Get object point cloud
+    pcl_conversions::fromPCL(cluster->header, object.header);
 
-        objects.push_back(object);
+    // Get cloud
+    {
+        point_cloud_proc::ScopedStageTimer serialization_timer(stage_stats_, point_cloud_proc::STATS_SERIALIZATION,
+                                                               cluster->points.size());
+        pcl::toROSMsg(*cluster, object.cloud);
+        serialization_timer.setPointsOut(cluster->points.size());
     }
 
-    if (debug_) {
-        object_poses_rviz.header.frame_id = cloud_tabletop_->header.frame_id;
-        object_poses_pub_.publish(object_poses_rviz);
+    object.normals.clear();
+    if (normals) {
+        // Get point normals
+        object.normals.reserve(cluster_normals->points.size());
+        for (int i = 0; i < cluster_normals->points.size(); i++) {
+            geometry_msgs::Vector3 normal;
+            normal.x = cluster_normals->points[i].normal_x;
+            normal.y = cluster_normals->points[i].normal_y;
+            normal.z = cluster_normals->points[i].normal_z;
+            object.normals.push_back(normal);
+        }
     }
-    return true;
+
+    object.pmin.x = geometry.pmin.x;
+    object.pmin.y = geometry.pmin.y;
+    object.pmin.z = geometry.pmin.z;
+
+    object.pmax.x = geometry.pmax.x;
+    object.pmax.y = geometry.pmax.y;
+    object.pmax.z = geometry.pmax.z;
+
+    // Get object center
+    object.center.x = geometry.center[0];
+    object.center.y = geometry.center[1];
+    object.center.z = geometry.center[2];
+
+    object.pose.position.x = geometry.center[0];
+    object.pose.position.y = geometry.center[1];
+    object.pose.position.z = geometry.center[2];
+
+    object.pose.orientation.x = geometry.orientation.x();
+    object.pose.orientation.y = geometry.orientation.y();
+    object.pose.orientation.z = geometry.orientation.z();
+    object.pose.orientation.w = geometry.orientation.w();
+
+    // Get min max points coords
+    object.min.x = geometry.min[0];
+    object.min.y = geometry.min[1];
+    object.min.z = geometry.min[2];
+    object.max.x = geometry.max[0];
+    object.max.y = geometry.max[1];
+    object.max.z = geometry.max[2];
 }
 
 bool PointCloudProc::projectPointCloudToPlane(sensor_msgs::PointCloud2 &cloud_in,
@@ -639,10 +1099,11 @@ bool PointCloudProc::projectPointCloudToPlane(sensor_msgs::PointCloud2 &cloud_in
     CloudT::Ptr cloud_out_pcl(new CloudT);
     pcl::fromROSMsg(cloud_in, *cloud_in_pcl);
 
-    plane_proj_.setModelType(pcl::SACMODEL_PLANE);
-    plane_proj_.setModelCoefficients(plane_coeffs);
-    plane_proj_.setInputCloud(cloud_in_pcl);
-    plane_proj_.filter(*cloud_out_pcl);
+    WorkspaceLease ws(*this);
+    ws->plane_proj.setModelType(pcl::SACMODEL_PLANE);
+    ws->plane_proj.setModelCoefficients(plane_coeffs);
+    ws->plane_proj.setInputCloud(cloud_in_pcl);
+    ws->plane_proj.filter(*cloud_out_pcl);
 
     pcl::toROSMsg(*cloud_out_pcl, cloud_out);
 
@@ -651,20 +1112,23 @@ bool PointCloudProc::projectPointCloudToPlane(sensor_msgs::PointCloud2 &cloud_in
 
 bool PointCloudProc::get3DPoint(int col, int row, geometry_msgs::PointStamped &point) {
 
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
+    FrameContext::Ptr frame = newFrame();
+    bool transformed = transformFrame(*frame);
+    setLastFrame(frame);
+    if (!transformed) {
+        ROS_WARN("PCP: couldn't transform point cloud!");
         return false;
     }
 
-    pcl_conversions::fromPCL(cloud_transformed_->header, point.header);
+    pcl_conversions::fromPCL(frame->cloud_transformed->header, point.header);
 
-    if (pcl::isFinite(cloud_transformed_->at(col, row))) {
-        point.point.x = cloud_transformed_->at(col, row).x;
-        point.point.y = cloud_transformed_->at(col, row).y;
-        point.point.z = cloud_transformed_->at(col, row).z;
+    if (pcl::isFinite(frame->cloud_transformed->at(col, row))) {
+        point.point.x = frame->cloud_transformed->at(col, row).x;
+        point.point.y = frame->cloud_transformed->at(col, row).y;
+        point.point.z = frame->cloud_transformed->at(col, row).z;
         return true;
     } else {
-        std::cout << "PCP: The 3D point is not valid!" << std::endl;
+        ROS_WARN("PCP: The 3D point is not valid!");
         return false;
     }
 
@@ -672,29 +1136,33 @@ bool PointCloudProc::get3DPoint(int col, int row, geometry_msgs::PointStamped &p
 
 bool PointCloudProc::getObjectFromBBox(int *bbox, point_cloud_proc::Object &object) {
 
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
+    FrameContext::Ptr frame = newFrame();
+    bool transformed = transformFrame(*frame);
+    setLastFrame(frame);
+    if (!transformed) {
+        ROS_WARN("PCP: couldn't transform point cloud!");
         return false;
     }
 
-    pcl_conversions::fromPCL(cloud_transformed_->header, object.header);
+    pcl_conversions::fromPCL(frame->cloud_transformed->header, object.header);
 
-    CloudT::Ptr object_cloud(new CloudT);
-    CloudT::Ptr object_cloud_filtered(new CloudT);
-    object_cloud->header = cloud_transformed_->header;
+    WorkspaceLease ws(*this);
+    CloudT::Ptr object_cloud = ws->arena.cloud();
+    CloudT::Ptr object_cloud_filtered = ws->arena.cloud();
+    object_cloud->header = frame->cloud_transformed->header;
 
     for (int i = bbox[0]; i < bbox[2]; i++) {
         for (int j = bbox[1]; j < bbox[3]; j++) {
-            if (pcl::isFinite(cloud_transformed_->at(i, j))) {
-                object_cloud->push_back(cloud_transformed_->at(i, j));
+            if (pcl::isFinite(frame->cloud_transformed->at(i, j))) {
+                object_cloud->push_back(frame->cloud_transformed->at(i, j));
             }
         }
 
     }
 
-    removeOutliers(object_cloud, object_cloud_filtered);
+    removeOutliers(object_cloud, object_cloud_filtered, *ws);
     if (object_cloud_filtered->empty()) {
-        std::cout << "PCP: object cloud is empty after removing outliers!" << std::endl;
+        ROS_WARN("PCP: object cloud is empty after removing outliers!");
         return false;
     }
 
@@ -722,64 +1190,63 @@ bool PointCloudProc::getObjectFromBBox(int *bbox, point_cloud_proc::Object &obje
 
 bool PointCloudProc::getObjectFromContour(const std::vector<int> &contour_x, const std::vector<int> &contour_y,
                                           point_cloud_proc::Object &object) {
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
+    FrameContext::Ptr frame = newFrame();
+    bool transformed = transformFrame(*frame);
+    setLastFrame(frame);
+    if (!transformed) {
+        ROS_WARN("PCP: couldn't transform point cloud!");
         return false;
     }
 
-    if(cloud_transformed_->height == 1){
-        std::cout << "PCP: transformed cloud is not organized!" << std::endl;
+    if(frame->cloud_transformed->height == 1){
+        ROS_WARN("PCP: transformed cloud is not organized!");
     }
-    pcl_conversions::fromPCL(cloud_transformed_->header, object.header);
+    pcl_conversions::fromPCL(frame->cloud_transformed->header, object.header);
 
-    CloudT::Ptr object_cloud(new CloudT);
-    CloudT::Ptr object_cloud_filtered(new CloudT);
-    object_cloud->header = cloud_transformed_->header;
+    WorkspaceLease ws(*this);
+    CloudT::Ptr object_cloud = ws->arena.cloud();
+    CloudT::Ptr object_cloud_filtered = ws->arena.cloud();
+    object_cloud->header = frame->cloud_transformed->header;
 
-    std::cout << "PCP: getting object cluster from contours..." << std::endl;
+    ROS_DEBUG("PCP: getting object cluster from contours...");
 
 
     for (int i = 0; i < contour_x.size(); i++){
-        if (pcl::isFinite(cloud_transformed_->at(contour_y[i], contour_x[i]))){
-            object_cloud->push_back(cloud_transformed_->at(contour_y[i], contour_x[i]));
+        if (pcl::isFinite(frame->cloud_transformed->at(contour_y[i], contour_x[i]))){
+            object_cloud->push_back(frame->cloud_transformed->at(contour_y[i], contour_x[i]));
         }
 
     }
 
-    CloudT::Ptr object_cloud_plane(new CloudT);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+    CloudT::Ptr object_cloud_plane = ws->arena.cloud();
+    pcl::ModelCoefficients::Ptr coefficients = ws->arena.coefficients();
+    pcl::PointIndices::Ptr inliers = ws->arena.indices();
 
-    seg_.setOptimizeCoefficients(true);
-    seg_.setMaxIterations(max_iter_);
-    seg_.setModelType(pcl::SACMODEL_PLANE);
-    seg_.setMethodType(pcl::SAC_RANSAC);
-    seg_.setDistanceThreshold(single_dist_thresh_);
-    seg_.setInputCloud(object_cloud);
-    seg_.segment(*inliers, *coefficients);
+    ws->segmenter.fitPlane(object_cloud, pcl::PointIndices::Ptr(), single_dist_thresh_, Eigen::Vector3f::Zero(),
+                           *inliers, *coefficients);
 
 
     if (inliers->indices.size() == 0) {
-        std::cout << "PCP: plane is empty!" << std::endl;
+        ROS_WARN("PCP: plane is empty!");
         return false;
     }
 
-    extract_.setInputCloud(object_cloud);
-    extract_.setNegative(false);
-    extract_.setIndices(inliers);
-    extract_.filter(*object_cloud_plane);
+    ws->extract.setInputCloud(object_cloud);
+    ws->extract.setNegative(false);
+    ws->extract.setIndices(inliers);
+    ws->extract.filter(*object_cloud_plane);
 
 
     // If this one keeps filtering all pointclouds, try adjusting the filter parameter in 
     // config file
-    removeOutliers(object_cloud, object_cloud_filtered);
+    removeOutliers(object_cloud, object_cloud_filtered, *ws);
     
     sensor_msgs::PointCloud2 cloud_ros;
     pcl::toROSMsg(*object_cloud_filtered, cloud_ros);
     debug_cloud_pub_.publish(cloud_ros);
 
     if (object_cloud_filtered->empty()) {
-        std::cout << "PCP: object cloud is empty after removing outliers!" << std::endl;
+        ROS_WARN("PCP: object cloud is empty after removing outliers!");
         return false;
     }
 
@@ -805,7 +1272,8 @@ bool PointCloudProc::getObjectFromContour(const std::vector<int> &contour_x, con
     object.pose.position.z = center[2];
 
     PointT pmin, pmax;
-    pcl::getMaxSegment(*object_cloud_plane, pmin, pmax);
+    point_cloud_proc::computeDiameter(*object_cloud_plane, params_.diameter_method, pmin, pmax,
+                                      params_.diameter_max_error);
 
     object.pmax.x = pmax.x;
     object.pmax.y = pmax.y;
@@ -871,15 +1339,12 @@ bool PointCloudProc::getObjectFromContour(const std::vector<int> &contour_x, con
 
 bool PointCloudProc::generateMeshFromPointCloud(sensor_msgs::PointCloud2 &cloud, pcl_msgs::PolygonMesh &mesh) {
 
-    pcl::NormalEstimationOMP<pcl::PointXYZ, PointNT> ne(6);
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_in(new pcl::PointCloud<pcl::PointXYZ>);
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_in_filtered(new pcl::PointCloud<pcl::PointXYZ>);
 
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree1(new pcl::search::KdTree<pcl::PointXYZ>());
     pcl::search::KdTree<pcl::PointNormal>::Ptr tree2 (new pcl::search::KdTree<pcl::PointNormal>);
 
 
-    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
     pcl::PointCloud<pcl::PointNormal>::Ptr cloud_normals(new pcl::PointCloud<pcl::PointNormal>);
 
     pcl::fromROSMsg(cloud, *cloud_in);
@@ -893,14 +1358,9 @@ bool PointCloudProc::generateMeshFromPointCloud(sensor_msgs::PointCloud2 &cloud,
 //    vg.filter(*cloud_in_filtered);
 
 
-    tree1->setInputCloud(cloud_in);
-    ne.setInputCloud(cloud_in);
-    ne.setSearchMethod(tree1);
-    ne.setKSearch(40);
-//    ne.setRadiusSearch(0.01);
-    ne.compute(*normals);
-
-    pcl::concatenateFields(*cloud_in, *normals, *cloud_normals);
+    WorkspaceLease ws(*this);
+    ws->mesh_normal_engine.setKSearch(40);
+    pcl::concatenateFields(*cloud_in, *ws->mesh_normal_engine.compute(cloud_in), *cloud_normals);
 
 //    for(size_t i = 0; i < cloud_normals->size(); ++i){
 //        cloud_normals->points[i].normal_x *= -1;
@@ -924,7 +1384,7 @@ bool PointCloudProc::generateMeshFromPointCloud(sensor_msgs::PointCloud2 &cloud,
 
     pcl_conversions::fromPCL(pcl_mesh, mesh);
 
-    std::cout << "PCP: # of triangles : " << pcl_mesh.polygons.size() << std::endl;
+    ROS_DEBUG("PCP: # of triangles : %zu", pcl_mesh.polygons.size());
 
     return true;
 
@@ -943,35 +1403,28 @@ bool PointCloudProc::trianglePointCloud(sensor_msgs::PointCloud2 &cloud, pcl_msg
     vg.filter(*cloud_xyz);
 
     // Compute point normals
-    pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
-    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
     pcl::PointCloud<pcl::PointNormal>::Ptr cloud_normals(new pcl::PointCloud<pcl::PointNormal>);
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>());
-
-    tree->setInputCloud(cloud_xyz);
-    ne.setInputCloud(cloud_xyz);
-    ne.setSearchMethod(tree);
-    ne.setKSearch(20);
-    ne.compute(*normals);
-
-    pcl::concatenateFields(*cloud_xyz, *normals, *cloud_normals);
+    WorkspaceLease ws(*this);
+    ws->mesh_normal_engine.setKSearch(20);
+    pcl::concatenateFields(*cloud_xyz, *ws->mesh_normal_engine.compute(cloud_xyz), *cloud_normals);
 
     pcl::search::KdTree<pcl::PointNormal>::Ptr tree2(new pcl::search::KdTree<pcl::PointNormal>);
     tree2->setInputCloud(cloud_normals);
 
 //  pcl::PolygonMesh triangles;
     pcl::PolygonMesh::Ptr triangles(new pcl::PolygonMesh());
-    gp3_.setSearchRadius(0.2);
-    gp3_.setMu(2.5);
-    gp3_.setMaximumNearestNeighbors(100);
-    gp3_.setMaximumSurfaceAngle(M_PI / 4); // 45 degrees
-    gp3_.setMinimumAngle(M_PI / 18); // 10 degrees
-    gp3_.setMaximumAngle(2 * M_PI / 3); // 120 degrees
-    gp3_.setNormalConsistency(false);
+    pcl::GreedyProjectionTriangulation<pcl::PointNormal> &gp3 = ws->gp3;
+    gp3.setSearchRadius(0.2);
+    gp3.setMu(2.5);
+    gp3.setMaximumNearestNeighbors(100);
+    gp3.setMaximumSurfaceAngle(M_PI / 4); // 45 degrees
+    gp3.setMinimumAngle(M_PI / 18); // 10 degrees
+    gp3.setMaximumAngle(2 * M_PI / 3); // 120 degrees
+    gp3.setNormalConsistency(false);
 
-    gp3_.setInputCloud(cloud_normals);
-    gp3_.setSearchMethod(tree2);
-    gp3_.reconstruct(*triangles);
+    gp3.setInputCloud(cloud_normals);
+    gp3.setSearchMethod(tree2);
+    gp3.reconstruct(*triangles);
 
 
     pcl_conversions::fromPCL(*triangles, mesh);
@@ -997,60 +1450,53 @@ bool PointCloudProc::trianglePointCloud(sensor_msgs::PointCloud2 &cloud, pcl_msg
 
 void PointCloudProc::getRemainingCloud(sensor_msgs::PointCloud2 &cloud) {
 //  sensor_msgs::PointCloud2::Ptr cloud;
-    pcl::toROSMsg(*cloud_filtered_, cloud);
+    pcl::toROSMsg(*lastFrame()->cloud_filtered, cloud);
 
 //  return cloud;
 }
 
 void PointCloudProc::getFilteredCloud(sensor_msgs::PointCloud2 &cloud) {
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
-    }
-
-    if (!filterPointCloud()) {
-        std::cout << "PCP: couldn't filter point cloud!" << std::endl;
-    }
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    transformAndFilterFrame(*frame, *ws);
+    setLastFrame(frame);
 
-    pcl::toROSMsg(*cloud_filtered_, cloud);
+    pcl::toROSMsg(*frame->cloud_filtered, cloud);
 }
 
 sensor_msgs::PointCloud2::Ptr PointCloudProc::getTabletopCloud() {
-    sensor_msgs::PointCloud2::Ptr cloud;
-    pcl::toROSMsg(*cloud_tabletop_, *cloud);
+    FrameContext::Ptr frame = lastFrame();
+    sensor_msgs::PointCloud2::Ptr cloud(new sensor_msgs::PointCloud2);
+    toROSMsg(point_cloud_proc::CloudView(*frame->cloud_filtered, &frame->tabletop_indices->indices), *cloud);
 
     return cloud;
 }
 
 sensor_msgs::PointCloud2::Ptr PointCloudProc::getFilteredCloud() {
     sensor_msgs::PointCloud2::Ptr filtered_cloud;
-    pcl::toROSMsg(*cloud_filtered_, *filtered_cloud);
+    pcl::toROSMsg(*lastFrame()->cloud_filtered, *filtered_cloud);
     // // debug_cloud_pub_.publish(filtered_cloud);
     return filtered_cloud;
 }
 
 pcl::PointIndices::Ptr PointCloudProc::getTabletopIndicies() {
-    return tabletop_indicies_;
+    return lastFrame()->tabletop_indices;
 }
 
 
 bool PointCloudProc::removePlane(pcl::PointCloud<pcl::PointXYZRGB> &segmented_point_cloud, char axis) {
-    // boost::mutex::scoped_lock lock(pc_mutex_);
-    std::cout << "PCP: segmenting single plane..." << std::endl;
-
-    if (!transformPointCloud()) {
-        std::cout << "PCP: couldn't transform point cloud!" << std::endl;
-        return false;
-    }
+    ROS_DEBUG("PCP: removing single plane...");
 
-    if (!filterPointCloud()) {
-        std::cout << "PCP: couldn't filter point cloud!" << std::endl;
+    FrameContext::Ptr frame = newFrame();
+    WorkspaceLease ws(*this);
+    if (!transformAndFilterFrame(*frame, *ws)) {
+        setLastFrame(frame);
         return false;
     }
 
 
-    CloudT::Ptr cloud_plane(new CloudT);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
+    pcl::ModelCoefficients::Ptr coefficients = ws->arena.coefficients();
+    pcl::PointIndices::Ptr inliers = ws->arena.indices();
 
     Eigen::Vector3f axis_vector = Eigen::Vector3f(0.0, 0.0, 0.0);
 
@@ -1062,29 +1508,24 @@ bool PointCloudProc::removePlane(pcl::PointCloud<pcl::PointXYZRGB> &segmented_po
         axis_vector[2] = 1.0;
     }
 
-    seg_.setOptimizeCoefficients(true);
-    seg_.setMaxIterations(max_iter_);
-//    seg_.setModelType(pcl::SACMODEL_PERPENDICULAR_PLANE);
-    seg_.setModelType(pcl::SACMODEL_PLANE);
-    seg_.setMethodType(pcl::SAC_RANSAC);
-//    seg_.setAxis(axis_vector);
-//    seg_.setEpsAngle(eps_angle_ * (M_PI / 180.0f));
-    seg_.setDistanceThreshold(single_dist_thresh_);
-    seg_.setInputCloud(cloud_filtered_);
-    seg_.segment(*inliers, *coefficients);
+    // The axis is not enforced here, any plane is removed
+    ws->segmenter.fitPlane(frame->cloud_filtered, pcl::PointIndices::Ptr(), single_dist_thresh_,
+                           Eigen::Vector3f::Zero(), *inliers, *coefficients);
 
 
     if (inliers->indices.size() == 0) {
-        std::cout << "PCP: plane is empty!" << std::endl;
+        ROS_WARN("PCP: plane is empty!");
+        setLastFrame(frame);
         return false;
     }
 
-    extract_.setInputCloud(cloud_filtered_); // After extractions, cloud_filtered should be all objects on the plane
-    extract_.setNegative(true); // Try changing this to true to get the inliers
-    extract_.setIndices(inliers);
-    extract_.filter(*cloud_filtered_);
+    // After removing the plane in place, cloud_filtered should be all objects
+    // on the plane
+    std::sort(inliers->indices.begin(), inliers->indices.end());
+    point_cloud_proc::removeIndices(*frame->cloud_filtered, inliers->indices);
+    setLastFrame(frame);
 
-    segmented_point_cloud = *cloud_filtered_;
+    segmented_point_cloud = *frame->cloud_filtered;
     debug_cloud_pub_.publish(segmented_point_cloud);
 
     return true;
@@ -1096,34 +1537,23 @@ bool PointCloudProc::filterPointCloudWithLimits(std::vector<float> set_limits,
                                                 CloudT::Ptr input_cloud,
                                                 CloudT::Ptr output_cloud) {
 
-    // Remove part of the scene to leave table and objects alone
-    pass_.setInputCloud(input_cloud);
-    pass_.setFilterFieldName("x");
-    pass_.setFilterLimits(set_limits[0], set_limits[1]);
-    pass_.filter(*output_cloud);
-    
-    pass_.setInputCloud(output_cloud);
-    pass_.setFilterFieldName("y");
-    pass_.setFilterLimits(set_limits[2], set_limits[3]);
-    pass_.filter(*output_cloud);
-    
+    WorkspaceLease ws(*this);
+    return filterWithLimits(set_limits, input_cloud, output_cloud, *ws);
+}
 
-    pass_.setInputCloud(output_cloud);
-    pass_.setFilterFieldName("z");
-    pass_.setFilterLimits(set_limits[4], set_limits[5]);
-    pass_.filter(*output_cloud);
+bool PointCloudProc::filterWithLimits(const std::vector<float> &set_limits, const CloudT::Ptr &input_cloud,
+                                      const CloudT::Ptr &output_cloud, Workspace &ws) {
 
-    
+    // Remove part of the scene to leave table and objects alone
+    point_cloud_proc::cropPointCloud(*input_cloud, set_limits, *output_cloud);
 
     if (output_cloud->points.size() == 0) {
-        std::cout << "PCP: point cloud is empty after filtering!" << std::endl;
+        ROS_DEBUG("PCP: point cloud is empty after filtering with limits");
         return false;
     }
 
     // Downsample point cloud
-    vg_.setInputCloud (output_cloud);
-    vg_.setLeafSize (leaf_size_, leaf_size_, leaf_size_);
-    vg_.filter (*output_cloud);
+    ws.segmenter.downsample(output_cloud, *output_cloud);
 
 
     pcl::StatisticalOutlierRemoval<pcl::PointXYZRGB> sor;
@@ -1138,9 +1568,42 @@ bool PointCloudProc::filterPointCloudWithLimits(std::vector<float> set_limits,
 
 bool PointCloudProc::findDropSpot(ros::Publisher drop_spot_pub)
 {
-    // Make drop of spot
     geometry_msgs::Point drop_off;
-    
+    bool found = false;
+    bool from_snapshot = streaming_ && streaming_drop_spot_;
+
+    if (from_snapshot) {
+        PipelineSnapshot::ConstPtr snapshot = currentSnapshot();
+        if (!snapshot) {
+            return false;
+        }
+        drop_off = snapshot->drop_spot;
+        found = snapshot->drop_spot_found;
+    } else {
+        FrameContext::Ptr frame = newFrame();
+        WorkspaceLease ws(*this);
+        found = transformFrame(*frame) && computeDropSpot(frame->cloud_transformed, drop_off, *ws);
+        setLastFrame(frame);
+    }
+
+    if (!found) {
+        ROS_INFO("Did not find any placable locations");
+        return false;
+    }
+
+    // publish the x y and z of the drop off point
+    drop_spot_pub.publish(drop_off);
+    ROS_INFO("Published");
+    // The snapshot is already there, only the synchronous path keeps the
+    // pause of the original node
+    if (!from_snapshot) {
+        ros::Duration(0.5).sleep();
+    }
+    return true;
+}
+
+bool PointCloudProc::computeDropSpot(const CloudT::Ptr &cloud, geometry_msgs::Point &drop_off, Workspace &ws)
+{
     float TRAY_LEFT = 0.16, TRAY_RIGHT = -0.16, TRAY_CENTER = 0;
     float TRAY_BACK = 1.25, TRAY_FRONT = 0.78, PLACE_OFFSET = 0.15;
     float TRAY_BOTTOM = 0.765, TRAY_TOP = 1.;
@@ -1149,61 +1612,241 @@ bool PointCloudProc::findDropSpot(ros::Publisher drop_spot_pub)
     std::vector<float> LEFT_SECTION{TRAY_FRONT, TRAY_BACK, TRAY_CENTER, TRAY_LEFT, TRAY_BOTTOM, TRAY_TOP};
     std::vector<float> RIGHT_SECTION{TRAY_FRONT, TRAY_BACK, TRAY_RIGHT, TRAY_CENTER, TRAY_BOTTOM, TRAY_TOP};
 
-    // Segment point cloud to tray dimensions
-    CloudT::Ptr segmented_point_cloud = getCloud();
-    if (!filterPointCloudWithLimits(TRAY_LIMITS, segmented_point_cloud, segmented_point_cloud))
+    // Segment point cloud to tray dimensions, cloud itself stays intact
+    CloudT::Ptr segmented_point_cloud = ws.arena.cloud();
+    if (!filterWithLimits(TRAY_LIMITS, cloud, segmented_point_cloud, ws))
     {
-        ROS_INFO("Tray is empty");
-        // publish the x y and z of the drop off point
+        ROS_DEBUG("Tray is empty");
         drop_off.x = TRAY_BACK - PLACE_OFFSET;
         drop_off.y = (TRAY_LEFT + TRAY_CENTER) / 2;
         drop_off.z = TRAY_TOP + FIXED_HEIGHT;
-        drop_spot_pub.publish(drop_off);
-        ros::Duration(0.5).sleep();
-        return true;    
-    }    
+        return true;
+    }
 
     // check if there is any space remaining on the left side
-    CloudT::Ptr left_side(new CloudT);
-    filterPointCloudWithLimits(LEFT_SECTION, segmented_point_cloud, left_side);
-    ROS_INFO("Got left side point cloud");
-    
+    CloudT::Ptr left_side = ws.arena.cloud();
+    filterWithLimits(LEFT_SECTION, segmented_point_cloud, left_side, ws);
+    ROS_DEBUG("Got left side point cloud");
+
     float min_x = getMinX(*left_side);
-    ROS_INFO("Min x: %f", min_x);
+    ROS_DEBUG("Min x: %f", min_x);
     if (min_x > TRAY_FRONT + PLACE_OFFSET)
     {
-        ROS_INFO("Found placable area");
-        // publish the x y and z of the drop off point
+        ROS_DEBUG("Found placable area");
         drop_off.x = min_x - PLACE_OFFSET;
         drop_off.y = (TRAY_LEFT + TRAY_CENTER) / 2;
         drop_off.z = TRAY_TOP + FIXED_HEIGHT;
-        drop_spot_pub.publish(drop_off);
-        ROS_INFO("Published");
-        ros::Duration(0.5).sleep();
         return true;
     }
 
 
-    ROS_INFO("Moving onto right side");
+    ROS_DEBUG("Moving onto right side");
     // otherwise, check if there is any space on the right side
-    CloudT::Ptr right_side(new CloudT);
-    filterPointCloudWithLimits(RIGHT_SECTION, segmented_point_cloud, right_side);
+    CloudT::Ptr right_side = ws.arena.cloud();
+    filterWithLimits(RIGHT_SECTION, segmented_point_cloud, right_side, ws);
     min_x = getMinX(*right_side);
     if (min_x > TRAY_FRONT + PLACE_OFFSET)
     {
-        // publish the x y and z of the drop off point
         drop_off.x = min_x - PLACE_OFFSET;
         drop_off.y = (TRAY_RIGHT) / 2;
         drop_off.z = TRAY_TOP + FIXED_HEIGHT;
-        drop_spot_pub.publish(drop_off);
-        ros::Duration(0.5).sleep();
         return true;
-    }   
-    ROS_INFO("Did not find any placable locations");
+    }
     // return false if neither side has space
     return false;
 }
 
+bool PointCloudProc::startStreaming()
+{
+    if (streaming_) {
+        return true;
+    }
+    if (offline_) {
+        ROS_ERROR("PCP: streaming needs a ROS master");
+        return false;
+    }
+    {
+        boost::mutex::scoped_lock lock(pc_mutex_);
+        streaming_stop_ = false;
+    }
+    filter_queue_.open(pipeline_queue_size_);
+    segment_queue_.open(pipeline_queue_size_);
+    cluster_queue_.open(pipeline_queue_size_);
+    streaming_ = true;
+
+    streaming_threads_.create_thread(boost::bind(&PointCloudProc::sourceLoop, this));
+    streaming_threads_.create_thread(boost::bind(&PointCloudProc::stageLoop, this, STAGE_FILTER,
+                                                 &filter_queue_, &segment_queue_));
+    streaming_threads_.create_thread(boost::bind(&PointCloudProc::stageLoop, this, STAGE_SEGMENT,
+                                                 &segment_queue_, &cluster_queue_));
+    streaming_threads_.create_thread(boost::bind(&PointCloudProc::stageLoop, this, STAGE_CLUSTER,
+                                                 &cluster_queue_, static_cast<FrameQueue *>(NULL)));
+    ROS_INFO("PCP: streaming started");
+    return true;
+}
+
+void PointCloudProc::stopStreaming()
+{
+    if (!streaming_) {
+        return;
+    }
+    {
+        boost::mutex::scoped_lock lock(pc_mutex_);
+        streaming_stop_ = true;
+    }
+    pc_cond_.notify_all();
+    filter_queue_.close();
+    segment_queue_.close();
+    cluster_queue_.close();
+    streaming_threads_.join_all();
+    {
+        boost::mutex::scoped_lock lock(pc_mutex_);
+        streaming_stop_ = false;
+    }
+    streaming_ = false;
+    snapshot_cond_.notify_all();
+    ROS_INFO("PCP: streaming stopped");
+}
+
+bool PointCloudProc::isStreaming() const
+{
+    return streaming_;
+}
+
+void PointCloudProc::sourceLoop()
+{
+    while (true) {
+        FrameContext::Ptr frame = newFrame();
+        {
+            // Short waits so stopStreaming() is noticed. The frame is taken
+            // under the same lock, a synchronous call can not consume it in
+            // between.
+            boost::mutex::scoped_lock lock(pc_mutex_);
+            while (!streaming_stop_ && !waitForCloud(lock, consumed_seq_, ros::Time(0), ros::Duration(0.1))) {
+                if (!ros::ok()) {
+                    return;
+                }
+            }
+            if (streaming_stop_) {
+                return;
+            }
+            takeFrame(lock, *frame);
+        }
+
+        // A frame that can not be transformed gives no snapshot
+        if (transformStage(*frame) && !filter_queue_.push(frame)) {
+            ROS_DEBUG("PCP: filter stage is behind, dropped the oldest frame");
+        }
+    }
+}
+
+void PointCloudProc::stageLoop(PipelineStage stage, FrameQueue *input, FrameQueue *output)
+{
+    FrameContext::Ptr frame;
+    while (input->pop(frame)) {
+        runStage(stage, *frame);
+        if (!output) {
+            publishSnapshot(*frame);
+        } else if (!output->push(frame)) {
+            ROS_DEBUG("PCP: pipeline stage %d is behind, dropped the oldest frame", stage + 1);
+        }
+        frame.reset();
+    }
+}
+
+void PointCloudProc::runStage(PipelineStage stage, FrameContext &frame)
+{
+    // Frames that fail a stage still pass through so the snapshot of the
+    // newest frame says so
+    switch (stage) {
+        case STAGE_TRANSFORM:
+            transformStage(frame);
+            break;
+        case STAGE_FILTER:
+            frame.filtered = filterStage(frame);
+            if (streaming_drop_spot_) {
+                WorkspaceLease ws(*this);
+                frame.drop_spot_found = ensureTransformedCloud(frame) &&
+                                        computeDropSpot(frame.cloud_transformed, frame.drop_spot, *ws);
+            }
+            break;
+        case STAGE_SEGMENT:
+            frame.plane_found = frame.filtered && segmentStage(frame, 'z');
+            break;
+        case STAGE_CLUSTER:
+            frame.objects_found = frame.plane_found && clusterStage(frame, streaming_normals_);
+            break;
+        default:
+            break;
+    }
+}
+
+void PointCloudProc::publishSnapshot(FrameContext &frame)
+{
+    boost::shared_ptr<PipelineSnapshot> snapshot(new PipelineSnapshot);
+    snapshot->stamp = frame.cloud_raw->header.stamp;
+    snapshot->latency = ros::WallTime::now() - frame.start;
+    snapshot->plane_found = frame.plane_found;
+    snapshot->objects_found = frame.objects_found;
+    snapshot->drop_spot_found = frame.drop_spot_found;
+    snapshot->plane = std::move(frame.plane);
+    snapshot->objects = std::move(frame.objects);
+    snapshot->drop_spot = frame.drop_spot;
+
+    {
+        boost::mutex::scoped_lock lock(snapshot_mutex_);
+        snapshot->seq = ++snapshot_seq_;
+        latest_snapshot_ = snapshot;
+    }
+    snapshot_cond_.notify_all();
+
+    ROS_DEBUG("PCP: snapshot %lu published %.2f ms after its frame", static_cast<unsigned long>(snapshot->seq),
+              snapshot->latency.toSec() * 1000.0);
+}
+
+PipelineSnapshot::ConstPtr PointCloudProc::getLatestSnapshot()
+{
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    return latest_snapshot_;
+}
+
+PipelineSnapshot::ConstPtr PointCloudProc::waitForSnapshot(const ros::Time &newer_than, const ros::Duration &timeout)
+{
+    boost::system_time deadline(boost::posix_time::pos_infin);
+    if (timeout > ros::Duration(0)) {
+        deadline = boost::get_system_time() + boost::posix_time::microseconds(timeout.toNSec() / 1000);
+    }
+
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    while (!latest_snapshot_ || latest_snapshot_->stamp <= newer_than) {
+        if (!ros::ok() || !streaming_) {
+            return PipelineSnapshot::ConstPtr();
+        }
+        boost::system_time wake_up = std::min(deadline,
+                boost::get_system_time() + boost::posix_time::milliseconds(100));
+        snapshot_cond_.timed_wait(lock, wake_up);
+        if (boost::get_system_time() >= deadline) {
+            break;
+        }
+    }
+    if (latest_snapshot_ && latest_snapshot_->stamp > newer_than) {
+        return latest_snapshot_;
+    }
+    return PipelineSnapshot::ConstPtr();
+}
+
+PipelineSnapshot::ConstPtr PointCloudProc::currentSnapshot()
+{
+    PipelineSnapshot::ConstPtr snapshot = getLatestSnapshot();
+    if (!snapshot) {
+        snapshot = waitForSnapshot(ros::Time(0), frame_timeout_);
+    }
+    if (!snapshot) {
+        ROS_ERROR("PCP: no snapshot of %s available", point_cloud_topic_.c_str());
+    }
+    return snapshot;
+}
+
 
 float PointCloudProc::getMinX(CloudT cloud)
 {
@@ -1217,10 +1860,87 @@ float PointCloudProc::getMinX(CloudT cloud)
     return min_x;
 }
 
+void PointCloudProc::getObjectPixelIndices(std::vector<pcl::PointIndices> &indices) {
+    indices = lastFrame()->object_pixel_indices;
+}
+
 PointCloudProc::CloudT::Ptr PointCloudProc::getCloud()
 {
-    transformPointCloud();
-    return cloud_transformed_;
+    FrameContext::Ptr frame = newFrame();
+    transformFrame(*frame);
+    setLastFrame(frame);
+    return frame->cloud_transformed;
+}
+
+ros::WallDuration PointCloudProc::getTransformLatency() const
+{
+    boost::mutex::scoped_lock lock(tf_mutex_);
+    return transform_latency_;
+}
+
+FrameStats PointCloudProc::getFrameStats()
+{
+    FrameStats frame_stats;
+    {
+        boost::mutex::scoped_lock lock(pc_mutex_);
+        frame_stats = frame_stats_;
+    }
+    frame_stats.pipeline_dropped = filter_queue_.dropped() + segment_queue_.dropped() + cluster_queue_.dropped();
+    frame_stats.scratch_allocations = scratch_allocations_;
+    return frame_stats;
+}
+
+point_cloud_proc::PipelineStats PointCloudProc::getPipelineStats() const
+{
+    point_cloud_proc::PipelineStats stats;
+    stage_stats_.get(stats);
+    return stats;
+}
+
+void PointCloudProc::resetPipelineStats()
+{
+    stage_stats_.reset();
+}
+
+void PointCloudProc::setInstrumentation(bool enabled)
+{
+    stage_stats_.setEnabled(enabled);
+}
+
+void PointCloudProc::publishDiagnostics(const ros::WallTimerEvent &event)
+{
+    point_cloud_proc::PipelineStats stats = getPipelineStats();
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = "point_cloud_proc: pipeline";
+    status.hardware_id = point_cloud_topic_;
+    status.message = stage_stats_.enabled() ? "instrumented" : "instrumentation off";
+
+    for (int i = 0; i < point_cloud_proc::NUM_STATS_STAGES; i++) {
+        const point_cloud_proc::StageCounters &counters = stats.stages[i];
+        if (counters.calls == 0) {
+            continue;
+        }
+        char value[160];
+        snprintf(value, sizeof(value), "calls %lu, mean %.3f ms, max %.3f ms, points in %lu, out %lu",
+                 static_cast<unsigned long>(counters.calls), counters.meanMs(), counters.maxMs(),
+                 static_cast<unsigned long>(counters.points_in), static_cast<unsigned long>(counters.points_out));
+        diagnostic_msgs::KeyValue key_value;
+        key_value.key = point_cloud_proc::statsStageName(static_cast<point_cloud_proc::StatsStage>(i));
+        key_value.value = value;
+        status.values.push_back(key_value);
+    }
+
+    diagnostic_msgs::KeyValue allocations;
+    allocations.key = "scratch_allocations";
+    allocations.value = std::to_string(scratch_allocations_.load());
+    status.values.push_back(allocations);
+
+    diagnostic_msgs::DiagnosticArray array;
+    array.header.stamp = ros::Time::now();
+    array.status.push_back(status);
+    diagnostics_pub_.publish(array);
 }
 
 void PointCloudProc::getDefaultDropSpot(ros::Publisher drop_spot_pub) {
@@ -0,0 +1,167 @@
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <point_cloud_proc/point_cloud_proc.h>
+#include <point_cloud_proc/latency_stats.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+// Serves the segmentation services of one PointCloudProc that stays up
+// between requests, so clients don't pay for the config, TF and buffers on
+// every call. Requests run concurrently on a multi-threaded spinner, the
+// point cloud subscription has a spinner of its own so it is never starved
+// by requests waiting for their frame.
+//
+// Private parameters:
+//   config        config file, default.yaml of the package when empty
+//   debug         publish the debug clouds
+//   threads       spinner threads for the services, 0 for one per core
+//   stats_period  seconds between latency reports, 0 to only report on exit
+//   window        requests per service the percentiles are taken over
+
+class PointCloudProcServer {
+public:
+    PointCloudProcServer(ros::NodeHandle &nh, ros::NodeHandle &cloud_nh, bool debug,
+                         const std::string &config, size_t window) :
+            pcp_(cloud_nh, debug, config) {
+
+        for (int i = 0; i < NUM_SERVICES; i++) {
+            stats_[i] = point_cloud_proc::LatencyStats(window);
+            failures_[i] = 0;
+        }
+
+        single_plane_srv_ = nh.advertiseService("segment_single_plane",
+                                                &PointCloudProcServer::singlePlaneCb, this);
+        multi_plane_srv_ = nh.advertiseService("segment_multi_plane",
+                                               &PointCloudProcServer::multiPlaneCb, this);
+        tabletop_srv_ = nh.advertiseService("extract_tabletop",
+                                            &PointCloudProcServer::tabletopCb, this);
+        clustering_srv_ = nh.advertiseService("cluster_tabletop",
+                                              &PointCloudProcServer::clusteringCb, this);
+    }
+
+    void report() {
+        for (int i = 0; i < NUM_SERVICES; i++) {
+            point_cloud_proc::LatencySummary summary;
+            uint64_t failures;
+            {
+                boost::mutex::scoped_lock lock(stats_mutex_);
+                summary = stats_[i].summary();
+                failures = failures_[i];
+            }
+            if (summary.count == 0) {
+                continue;
+            }
+            ROS_INFO("PCP: %s: %lu calls, %lu failed, mean %.1f ms, p50 %.1f ms, p95 %.1f ms, "
+                     "p99 %.1f ms, max %.1f ms", SERVICE_NAMES[i],
+                     static_cast<unsigned long>(summary.count), static_cast<unsigned long>(failures),
+                     summary.mean_ms, summary.p50_ms, summary.p95_ms, summary.p99_ms, summary.max_ms);
+        }
+    }
+
+    void reportCb(const ros::WallTimerEvent &) {
+        report();
+    }
+
+private:
+    enum Service {
+        SINGLE_PLANE,
+        MULTI_PLANE,
+        TABLETOP,
+        CLUSTERING,
+        NUM_SERVICES
+    };
+
+    static const char *SERVICE_NAMES[NUM_SERVICES];
+
+    void record(Service service, const ros::WallTime &start, bool success) {
+        double ms = (ros::WallTime::now() - start).toSec() * 1000.0;
+        boost::mutex::scoped_lock lock(stats_mutex_);
+        stats_[service].add(ms);
+        if (!success) {
+            failures_[service]++;
+        }
+    }
+
+    bool singlePlaneCb(point_cloud_proc::SinglePlaneSegmentation::Request &req,
+                       point_cloud_proc::SinglePlaneSegmentation::Response &res) {
+        ros::WallTime start = ros::WallTime::now();
+        res.success = pcp_.segmentSinglePlane(res.plane_object);
+        record(SINGLE_PLANE, start, res.success);
+        return true;
+    }
+
+    bool multiPlaneCb(point_cloud_proc::MultiPlaneSegmentation::Request &req,
+                      point_cloud_proc::MultiPlaneSegmentation::Response &res) {
+        ros::WallTime start = ros::WallTime::now();
+        res.success = pcp_.segmentMultiplePlane(res.planes);
+        record(MULTI_PLANE, start, res.success);
+        return true;
+    }
+
+    bool tabletopCb(point_cloud_proc::TabletopExtraction::Request &req,
+                    point_cloud_proc::TabletopExtraction::Response &res) {
+        ros::WallTime start = ros::WallTime::now();
+        res.success = pcp_.extractTabletop(res.object_cluster);
+        record(TABLETOP, start, res.success);
+        return true;
+    }
+
+    bool clusteringCb(point_cloud_proc::TabletopClustering::Request &req,
+                      point_cloud_proc::TabletopClustering::Response &res) {
+        ros::WallTime start = ros::WallTime::now();
+        res.success = pcp_.clusterObjects(res.objects);
+        record(CLUSTERING, start, res.success);
+        return true;
+    }
+
+    PointCloudProc pcp_;
+
+    ros::ServiceServer single_plane_srv_, multi_plane_srv_, tabletop_srv_, clustering_srv_;
+
+    boost::mutex stats_mutex_;
+    point_cloud_proc::LatencyStats stats_[NUM_SERVICES];
+    uint64_t failures_[NUM_SERVICES];
+};
+
+const char *PointCloudProcServer::SERVICE_NAMES[NUM_SERVICES] = {
+        "segment_single_plane", "segment_multi_plane", "extract_tabletop", "cluster_tabletop"
+};
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "point_cloud_proc_server");
+    ros::NodeHandle nh;
+    ros::NodeHandle private_nh("~");
+
+    std::string config = private_nh.param<std::string>("config", "");
+    bool debug = private_nh.param<bool>("debug", false);
+    int threads = private_nh.param<int>("threads", 4);
+    double stats_period = private_nh.param<double>("stats_period", 60.0);
+    int window = private_nh.param<int>("window", 1000);
+
+    // Clouds arrive on their own queue, a request waiting for the next frame
+    // must not hold the only thread that could deliver it
+    ros::NodeHandle cloud_nh;
+    ros::CallbackQueue cloud_queue;
+    cloud_nh.setCallbackQueue(&cloud_queue);
+
+    PointCloudProcServer server(nh, cloud_nh, debug, config, window > 0 ? window : 0);
+
+    ros::AsyncSpinner cloud_spinner(1, &cloud_queue);
+    cloud_spinner.start();
+
+    ros::WallTimer report_timer;
+    if (stats_period > 0.0) {
+        report_timer = nh.createWallTimer(ros::WallDuration(stats_period), &PointCloudProcServer::reportCb, &server);
+    }
+
+    ROS_INFO("PCP: serving with %u threads",
+             threads > 0 ? static_cast<unsigned int>(threads) : boost::thread::hardware_concurrency());
+    ros::MultiThreadedSpinner spinner(std::max(threads, 0));
+    spinner.spin();
+
+    cloud_spinner.stop();
+    server.report();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <point_cloud_proc/point_kernels.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PCP_X86_KERNELS
+#endif
+
+namespace point_cloud_proc {
+
+namespace {
+
+// The products are summed in the same order in every variant and no FMA is
+// used, so all of them return bit identical results.
+size_t transformCropScalar(float *x, float *y, float *z, size_t begin, size_t n,
+                           const float *m, const float *box, uint8_t *keep) {
+    size_t kept = 0;
+    for (size_t i = begin; i < n; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        float tx = m[0] * px + m[1] * py + m[2] * pz + m[3];
+        float ty = m[4] * px + m[5] * py + m[6] * pz + m[7];
+        float tz = m[8] * px + m[9] * py + m[10] * pz + m[11];
+        x[i] = tx;
+        y[i] = ty;
+        z[i] = tz;
+
+        bool inside = tx >= box[0] && tx <= box[1] &&
+                      ty >= box[2] && ty <= box[3] &&
+                      tz >= box[4] && tz <= box[5];
+        keep[i] = inside ? 1 : 0;
+        kept += keep[i];
+    }
+    return kept;
+}
+
+#ifdef PCP_X86_KERNELS
+
+__attribute__((target("sse4.1")))
+size_t transformCropSSE4(float *x, float *y, float *z, size_t n,
+                         const float *m, const float *box, uint8_t *keep) {
+    __m128 m_v[12], box_v[6];
+    for (int i = 0; i < 12; i++) {
+        m_v[i] = _mm_set1_ps(m[i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        box_v[i] = _mm_set1_ps(box[i]);
+    }
+
+    size_t kept = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+
+        __m128 tx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m_v[0], px), _mm_mul_ps(m_v[1], py)),
+                                          _mm_mul_ps(m_v[2], pz)), m_v[3]);
+        __m128 ty = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m_v[4], px), _mm_mul_ps(m_v[5], py)),
+                                          _mm_mul_ps(m_v[6], pz)), m_v[7]);
+        __m128 tz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m_v[8], px), _mm_mul_ps(m_v[9], py)),
+                                          _mm_mul_ps(m_v[10], pz)), m_v[11]);
+        _mm_storeu_ps(x + i, tx);
+        _mm_storeu_ps(y + i, ty);
+        _mm_storeu_ps(z + i, tz);
+
+        // Ordered compares are false for NaN
+        __m128 inside = _mm_and_ps(_mm_cmpge_ps(tx, box_v[0]), _mm_cmple_ps(tx, box_v[1]));
+        inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(ty, box_v[2]), _mm_cmple_ps(ty, box_v[3])));
+        inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(tz, box_v[4]), _mm_cmple_ps(tz, box_v[5])));
+
+        int mask = _mm_movemask_ps(inside);
+        for (int j = 0; j < 4; j++) {
+            keep[i + j] = (mask >> j) & 1;
+        }
+        kept += __builtin_popcount(mask);
+    }
+    return kept + transformCropScalar(x, y, z, i, n, m, box, keep);
+}
+
+__attribute__((target("avx2")))
+size_t transformCropAVX2(float *x, float *y, float *z, size_t n,
+                         const float *m, const float *box, uint8_t *keep) {
+    __m256 m_v[12], box_v[6];
+    for (int i = 0; i < 12; i++) {
+        m_v[i] = _mm256_set1_ps(m[i]);
+    }
+    for (int i = 0; i < 6; i++) {
+        box_v[i] = _mm256_set1_ps(box[i]);
+    }
+
+    size_t kept = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+
+        __m256 tx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m_v[0], px),
+                                                              _mm256_mul_ps(m_v[1], py)),
+                                                _mm256_mul_ps(m_v[2], pz)), m_v[3]);
+        __m256 ty = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m_v[4], px),
+                                                              _mm256_mul_ps(m_v[5], py)),
+                                                _mm256_mul_ps(m_v[6], pz)), m_v[7]);
+        __m256 tz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m_v[8], px),
+                                                              _mm256_mul_ps(m_v[9], py)),
+                                                _mm256_mul_ps(m_v[10], pz)), m_v[11]);
+        _mm256_storeu_ps(x + i, tx);
+        _mm256_storeu_ps(y + i, ty);
+        _mm256_storeu_ps(z + i, tz);
+
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(tx, box_v[0], _CMP_GE_OQ),
+                                      _mm256_cmp_ps(tx, box_v[1], _CMP_LE_OQ));
+        inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(ty, box_v[2], _CMP_GE_OQ),
+                                                     _mm256_cmp_ps(ty, box_v[3], _CMP_LE_OQ)));
+        inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(tz, box_v[4], _CMP_GE_OQ),
+                                                     _mm256_cmp_ps(tz, box_v[5], _CMP_LE_OQ)));
+
+        int mask = _mm256_movemask_ps(inside);
+        for (int j = 0; j < 8; j++) {
+            keep[i + j] = (mask >> j) & 1;
+        }
+        kept += __builtin_popcount(mask);
+    }
+    return kept + transformCropScalar(x, y, z, i, n, m, box, keep);
+}
+
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef PCP_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SIMD_SSE4;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+}
+
+SimdLevel simdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2:
+            return "avx2";
+        case SIMD_SSE4:
+            return "sse4.1";
+        default:
+            return "scalar";
+    }
+}
+
+size_t transformCropPoints(float *x, float *y, float *z, size_t n,
+                           const float *m, const float *box, uint8_t *keep) {
+    return transformCropPoints(simdLevel(), x, y, z, n, m, box, keep);
+}
+
+size_t transformCropPoints(SimdLevel level, float *x, float *y, float *z, size_t n,
+                           const float *m, const float *box, uint8_t *keep) {
+#ifdef PCP_X86_KERNELS
+    if (level == SIMD_AVX2 && simdLevel() == SIMD_AVX2) {
+        return transformCropAVX2(x, y, z, n, m, box, keep);
+    }
+    if (level >= SIMD_SSE4 && simdLevel() >= SIMD_SSE4) {
+        return transformCropSSE4(x, y, z, n, m, box, keep);
+    }
+#endif
+    return transformCropScalar(x, y, z, 0, n, m, box, keep);
+}
+
+}
@@ -0,0 +1,377 @@
+#include <point_cloud_proc/scene_segmenter.h>
+
+#include <pcl/common/common.h>
+#include <pcl/common/centroid.h>
+#include <pcl/common/io.h>
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/sample_consensus/method_types.h>
+#include <pcl/sample_consensus/model_types.h>
+#include <pcl/search/kdtree.h>
+#include <pcl/segmentation/planar_region.h>
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace point_cloud_proc {
+
+namespace {
+
+inline bool insideLimits(const pcl::PointXYZRGB &p, const std::vector<float> &limits) {
+    return p.x >= limits[0] && p.x <= limits[1] &&
+           p.y >= limits[2] && p.y <= limits[3] &&
+           p.z >= limits[4] && p.z <= limits[5];
+}
+
+}
+
+SegmenterParams::SegmenterParams() :
+        pass_limits(6, 0.0f), prism_limits(2, 0.0f), leaf_size(0.01f), hash_voxel_grid(false),
+        voxel_mode(VOXEL_COLOR_AVERAGE), monotone_hull(false), eps_angle(10.0f), max_iter(1000),
+        min_plane_size(3000), parallel_sac(false), sac_threads(0), sac_seed(0), sac_probability(0.99),
+        ne_max_depth_change(0.02f), ne_smoothing_size(10.0f), cluster_method(CLUSTER_KDTREE), cluster_tol(0.03f),
+        min_cluster_size(50), max_cluster_size(25000), organized_min_cluster_size(500),
+        organized_max_cluster_size(300000), k_search(50), ne_threads(0),
+        diameter_method(DIAMETER_PCL), diameter_max_error(0.01f) {}
+
+SceneSegmenter::SceneSegmenter(const SegmenterParams &params, StageStats *stats) :
+        params_(params), stats_(stats), tree_(new pcl::search::KdTree<PointT>),
+        remaining_(new pcl::PointIndices), hull_indices_(new std::vector<int>), cloud_masked_(new CloudT), organized_normals_(new CloudNT),
+        labels_(new pcl::PointCloud<pcl::Label>) {
+
+    plane_ransac_.setNumberOfThreads(params_.sac_threads);
+    plane_ransac_.setSeed(params_.sac_seed);
+    plane_ransac_.setProbability(params_.sac_probability);
+    plane_hull_.setCellSize(2.0f * params_.leaf_size);
+}
+
+void SceneSegmenter::configureFusedFilter(const Eigen::Affine3f &transform) {
+    fused_filter_.setTransform(transform);
+    fused_filter_.setLimits(params_.pass_limits);
+    fused_filter_.setLeafSize(params_.leaf_size);
+    fused_filter_.setVoxelMode(params_.voxel_mode);
+}
+
+bool SceneSegmenter::crop(const CloudT &cloud_in, CloudT &cloud_out) {
+
+    ScopedStageTimer timer(stats_, STATS_CROP, cloud_in.points.size());
+    cropPointCloud(cloud_in, params_.pass_limits, cloud_out);
+    timer.setPointsOut(cloud_out.points.size());
+    return !cloud_out.points.empty();
+}
+
+bool SceneSegmenter::crop(const CloudT &cloud_in, const std::vector<uint8_t> &inside, CloudT &cloud_out) {
+
+    ScopedStageTimer timer(stats_, STATS_CROP, cloud_in.points.size());
+    cropPointCloud(cloud_in, inside, cloud_out);
+    timer.setPointsOut(cloud_out.points.size());
+    return !cloud_out.points.empty();
+}
+
+void SceneSegmenter::cropIndices(const CloudT &cloud, pcl::PointIndices &inside) const {
+
+    inside.header = cloud.header;
+    inside.indices.clear();
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        if (insideLimits(cloud.points[i], params_.pass_limits)) {
+            inside.indices.push_back(i);
+        }
+    }
+}
+
+void SceneSegmenter::downsample(const CloudT::Ptr &cloud_in, CloudT &cloud_out) {
+
+    ScopedStageTimer timer(stats_, STATS_VOXEL, cloud_in->points.size());
+    if (params_.hash_voxel_grid) {
+        voxel_grid_.setLeafSize(params_.leaf_size);
+        voxel_grid_.setMode(params_.voxel_mode);
+        voxel_grid_.filter(*cloud_in, cloud_out);
+    } else {
+        vg_.setInputCloud(cloud_in);
+        vg_.setLeafSize(params_.leaf_size, params_.leaf_size, params_.leaf_size);
+        vg_.filter(cloud_out);
+    }
+    timer.setPointsOut(cloud_out.points.size());
+}
+
+bool SceneSegmenter::fitPlane(const CloudT::Ptr &cloud, const pcl::PointIndices::Ptr &indices, float dist_thresh,
+                              const Eigen::Vector3f &axis, pcl::PointIndices &inliers,
+                              pcl::ModelCoefficients &coefficients) {
+
+    float eps_angle = params_.eps_angle * (M_PI / 180.0f);
+
+    ScopedStageTimer timer(stats_, STATS_RANSAC, indices ? indices->indices.size() : cloud->points.size());
+    if (params_.parallel_sac) {
+        plane_ransac_.setInputCloud(cloud);
+        plane_ransac_.setIndices(indices);
+        plane_ransac_.setDistanceThreshold(dist_thresh);
+        plane_ransac_.setMaxIterations(params_.max_iter);
+        plane_ransac_.setAxis(axis, eps_angle);
+        bool found = plane_ransac_.segment(inliers, coefficients);
+        timer.setPointsOut(inliers.indices.size());
+        return found;
+    }
+
+    seg_.setOptimizeCoefficients(true);
+    seg_.setMaxIterations(params_.max_iter);
+    seg_.setModelType(axis.isZero() ? pcl::SACMODEL_PLANE : pcl::SACMODEL_PERPENDICULAR_PLANE);
+    seg_.setMethodType(pcl::SAC_RANSAC);
+    seg_.setAxis(axis);
+    seg_.setEpsAngle(eps_angle);
+    seg_.setDistanceThreshold(dist_thresh);
+    seg_.setInputCloud(cloud);
+    if (indices && !indices->indices.empty()) {
+        seg_.setIndices(indices);
+    } else {
+        seg_.setIndices(pcl::IndicesPtr());
+    }
+    seg_.segment(inliers, coefficients);
+    timer.setPointsOut(inliers.indices.size());
+    return !inliers.indices.empty();
+}
+
+void SceneSegmenter::fitPlanes(const CloudT::Ptr &cloud, float dist_thresh, std::vector<pcl::PointIndices> &inliers,
+                               std::vector<pcl::ModelCoefficients> &coefficients, pcl::PointIndices &remaining) {
+
+    // Planes are removed by masking their indices out of the remaining set
+    // instead of rewriting the cloud after every plane
+    std::vector<int> &left = remaining_->indices;
+    left.resize(cloud->points.size());
+    for (size_t i = 0; i < left.size(); i++) {
+        left[i] = i;
+    }
+    is_inlier_.assign(cloud->points.size(), 0);
+
+    pcl::PointIndices plane_inliers;
+    pcl::ModelCoefficients plane_coefficients;
+    while (static_cast<int>(left.size()) >= params_.min_plane_size) {
+
+        fitPlane(cloud, remaining_, dist_thresh, Eigen::Vector3f::Zero(), plane_inliers, plane_coefficients);
+
+        if (static_cast<int>(plane_inliers.indices.size()) < params_.min_plane_size) {
+            break;
+        }
+
+        for (int index : plane_inliers.indices) {
+            is_inlier_[index] = 1;
+        }
+        const std::vector<uint8_t> &is_inlier = is_inlier_;
+        left.erase(std::remove_if(left.begin(), left.end(), [&is_inlier](int index) { return is_inlier[index]; }),
+                   left.end());
+
+        inliers.push_back(plane_inliers);
+        coefficients.push_back(plane_coefficients);
+    }
+
+    remaining.header = cloud->header;
+    remaining.indices = left;
+}
+
+bool SceneSegmenter::fitOrganizedPlanes(const CloudT &cloud, const CloudT &cloud_transformed,
+                                        const Eigen::Affine3f &transform, float dist_thresh,
+                                        std::vector<pcl::PointIndices> &inliers,
+                                        std::vector<pcl::ModelCoefficients> &coefficients) {
+
+    // Normals and planes are found on the image grid in the sensor frame,
+    // where z is the depth integral image normals expect. Points outside of
+    // the pass limits in the fixed frame are masked out with NaNs.
+    CloudT &cloud_masked = *cloud_masked_;
+    cloud_masked = cloud;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (size_t i = 0; i < cloud_transformed.points.size(); i++) {
+        if (!insideLimits(cloud_transformed.points[i], params_.pass_limits)) {
+            cloud_masked.points[i].x = cloud_masked.points[i].y = cloud_masked.points[i].z = nan;
+        }
+    }
+    cloud_masked.is_dense = false;
+
+    pcl::IntegralImageNormalEstimation<PointT, pcl::Normal> ne;
+    ne.setNormalEstimationMethod(ne.COVARIANCE_MATRIX);
+    ne.setMaxDepthChangeFactor(params_.ne_max_depth_change);
+    ne.setNormalSmoothingSize(params_.ne_smoothing_size);
+    ne.setInputCloud(cloud_masked_);
+    ne.compute(*organized_normals_);
+
+    std::vector<pcl::PlanarRegion<PointT>, Eigen::aligned_allocator<pcl::PlanarRegion<PointT> > > regions;
+    std::vector<pcl::ModelCoefficients> model_coefficients;
+    std::vector<pcl::PointIndices> inlier_indices, label_indices, boundary_indices;
+
+    pcl::OrganizedMultiPlaneSegmentation<PointT, pcl::Normal, pcl::Label> mps;
+    mps.setMinInliers(params_.min_plane_size);
+    mps.setAngularThreshold(params_.eps_angle * (M_PI / 180.0f));
+    mps.setDistanceThreshold(dist_thresh);
+    mps.setInputNormals(organized_normals_);
+    mps.setInputCloud(cloud_masked_);
+    mps.segmentAndRefine(regions, model_coefficients, inlier_indices, labels_, label_indices, boundary_indices);
+
+    const Eigen::Matrix3f rotation = transform.linear();
+    const Eigen::Vector3f translation = transform.translation();
+
+    for (size_t i = 0; i < model_coefficients.size(); i++) {
+
+        // Inlier indices are the same in the transformed cloud, the plane
+        // n.p + d = 0 becomes (R n).p' + d - (R n).t = 0
+        const std::vector<float> &values = model_coefficients[i].values;
+        Eigen::Vector3f normal = rotation * Eigen::Vector3f(values[0], values[1], values[2]);
+        pcl::ModelCoefficients plane_coefficients;
+        plane_coefficients.header = cloud_transformed.header;
+        plane_coefficients.values.resize(4);
+        plane_coefficients.values[0] = normal[0];
+        plane_coefficients.values[1] = normal[1];
+        plane_coefficients.values[2] = normal[2];
+        plane_coefficients.values[3] = values[3] - normal.dot(translation);
+
+        inliers.push_back(inlier_indices[i]);
+        coefficients.push_back(plane_coefficients);
+    }
+
+    return !model_coefficients.empty();
+}
+
+void SceneSegmenter::computeHull(const CloudT::Ptr &cloud, const std::vector<int> *indices,
+                                 const pcl::ModelCoefficients &coefficients, CloudT &hull) {
+
+    ScopedStageTimer timer(stats_, STATS_HULL, indices ? indices->size() : cloud->points.size());
+    if (params_.monotone_hull) {
+        plane_hull_.computeHull(*cloud, indices, coefficients, hull);
+    } else {
+        boost::mutex::scoped_lock lock(qhullMutex());
+        chull_.setInputCloud(cloud);
+        if (indices) {
+            *hull_indices_ = *indices;
+            chull_.setIndices(hull_indices_);
+        }
+        chull_.setDimension(2);
+        chull_.reconstruct(hull);
+        chull_.setIndices(pcl::IndicesPtr());
+    }
+    timer.setPointsOut(hull.points.size());
+}
+
+void SceneSegmenter::segmentPrism(const CloudT::Ptr &cloud, const pcl::PointIndices::Ptr &indices,
+                                  const CloudT::Ptr &hull, pcl::PointIndices &inside) {
+
+    ScopedStageTimer timer(stats_, STATS_PRISM, indices ? indices->indices.size() : cloud->points.size());
+    inside.header = cloud->header;
+    if (params_.monotone_hull) {
+        prism_hull_.setHeightLimits(params_.prism_limits[0], params_.prism_limits[1]);
+        prism_hull_.setHull(*hull);
+        prism_hull_.segment(*cloud, indices ? &indices->indices : NULL, inside.indices);
+        timer.setPointsOut(inside.indices.size());
+        return;
+    }
+
+    prism_.setInputCloud(cloud);
+    if (indices) {
+        prism_.setIndices(indices);
+    }
+    prism_.setInputPlanarHull(hull);
+    prism_.setHeightLimits(params_.prism_limits[0], params_.prism_limits[1]);
+    prism_.segment(inside);
+    // An empty pointer selects all points again for the next call
+    prism_.setIndices(pcl::IndicesPtr());
+    timer.setPointsOut(inside.indices.size());
+}
+
+void SceneSegmenter::cluster(const CloudT::Ptr &cloud, const pcl::PointIndices::ConstPtr &indices,
+                             std::vector<pcl::PointIndices> &clusters) {
+
+    ScopedStageTimer timer(stats_, STATS_CLUSTERING, indices ? indices->indices.size() : cloud->points.size());
+    if (params_.cluster_method == CLUSTER_GRID) {
+        grid_ec_.setClusterTolerance(params_.cluster_tol);
+        grid_ec_.setMinClusterSize(params_.min_cluster_size);
+        grid_ec_.setMaxClusterSize(params_.max_cluster_size);
+        grid_ec_.setInputCloud(cloud);
+        grid_ec_.setIndices(indices);
+        grid_ec_.extract(clusters);
+        grid_ec_.setIndices(pcl::PointIndices::ConstPtr());
+    } else {
+        // The search tree is built by extract() over the indices only
+        ec_.setClusterTolerance(params_.cluster_tol);
+        ec_.setMinClusterSize(params_.min_cluster_size);
+        ec_.setMaxClusterSize(params_.max_cluster_size);
+        ec_.setSearchMethod(tree_);
+        ec_.setInputCloud(cloud);
+        if (indices) {
+            ec_.setIndices(indices);
+        }
+        ec_.extract(clusters);
+        ec_.setIndices(pcl::IndicesPtr());
+    }
+
+    size_t clustered_points = 0;
+    for (const pcl::PointIndices &cluster : clusters) {
+        clustered_points += cluster.indices.size();
+    }
+    timer.setPointsOut(clustered_points);
+}
+
+void SceneSegmenter::clusterOrganized(const CloudT::Ptr &cloud, const std::vector<int> &indices,
+                                      std::vector<pcl::PointIndices> &clusters) {
+
+    ScopedStageTimer timer(stats_, STATS_CLUSTERING, indices.size());
+    extractOrganizedClusters(cloud, indices, params_.cluster_tol, params_.organized_min_cluster_size,
+                             params_.organized_max_cluster_size, clusters);
+
+    size_t clustered_points = 0;
+    for (const pcl::PointIndices &cluster : clusters) {
+        clustered_points += cluster.indices.size();
+    }
+    timer.setPointsOut(clustered_points);
+}
+
+SceneSegmenter::CloudNT::ConstPtr SceneSegmenter::computeNormals(NormalEngine<PointT> &engine,
+                                                                  const CloudT::Ptr &cloud,
+                                                                  const pcl::PointIndices::Ptr &indices,
+                                                                  const NormalSource &source) const {
+
+    size_t points = indices ? indices->indices.size() : cloud->points.size();
+    ScopedStageTimer timer(stats_, STATS_NORMALS, points);
+    engine.setKSearch(params_.k_search);
+    CloudNT::ConstPtr normals = engine.compute(cloud, indices, source);
+    timer.setPointsOut(points);
+    return normals;
+}
+
+void SceneSegmenter::computeObject(const CloudT &cloud, const pcl::PointIndices &indices, CloudT &cluster,
+                                   ObjectGeometry &geometry) const {
+
+    ScopedStageTimer timer(stats_, STATS_OBJECT_FEATURES, indices.indices.size());
+    pcl::copyPointCloud(cloud, indices, cluster);
+    timer.setPointsOut(cluster.points.size());
+
+    // Find position
+    pcl::compute3DCentroid(cluster, geometry.center);
+
+    // Find orientetions
+    // Get max segment
+    computeDiameter(cluster, params_.diameter_method, geometry.pmin, geometry.pmax, params_.diameter_max_error);
+    Eigen::Vector3d y_axis (geometry.pmin.x-geometry.pmax.x, geometry.pmin.y-geometry.pmax.y, 0.0);
+    y_axis.normalize();
+    Eigen::Vector3d z_axis (0.0, 0.0, 1.0);
+    Eigen::Vector3d x_axis = y_axis.cross(z_axis);
+
+    Eigen::Matrix3d rot;
+    rot << x_axis(0), y_axis(0), z_axis(0),
+           x_axis(1), y_axis(1), z_axis(1),
+           x_axis(2), y_axis(2), z_axis(1);
+
+    geometry.orientation = Eigen::Quaterniond(rot);
+
+    // Get min max points coords
+    pcl::getMinMax3D(cluster, geometry.min, geometry.max);
+}
+
+void SceneSegmenter::releaseInputs() {
+    seg_.setInputCloud(CloudT::ConstPtr());
+    chull_.setInputCloud(CloudT::ConstPtr());
+    prism_.setInputCloud(CloudT::ConstPtr());
+    prism_.setInputPlanarHull(CloudT::ConstPtr());
+    ec_.setInputCloud(CloudT::ConstPtr());
+    grid_ec_.setInputCloud(CloudT::ConstPtr());
+    plane_ransac_.setInputCloud(CloudT::ConstPtr());
+    plane_ransac_.setIndices(pcl::PointIndices::ConstPtr());
+}
+
+}
@@ -0,0 +1,105 @@
+#include <point_cloud_proc/scratch_arena.h>
+
+namespace point_cloud_proc {
+
+namespace {
+
+// Elements the buffer can hold without allocating
+inline size_t capacity(const pcl::PointCloud<pcl::PointXYZRGB> &cloud) {
+    return cloud.points.capacity();
+}
+
+inline size_t capacity(const pcl::PointIndices &indices) {
+    return indices.indices.capacity();
+}
+
+inline size_t capacity(const pcl::ModelCoefficients &coefficients) {
+    return coefficients.values.capacity();
+}
+
+}
+
+bool recycle(pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud) {
+    if (!cloud || !cloud.unique()) {
+        cloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+        return true;
+    }
+    cloud->header = pcl::PCLHeader();
+    cloud->points.clear();
+    cloud->width = 0;
+    cloud->height = 0;
+    cloud->is_dense = true;
+    return false;
+}
+
+bool recycle(pcl::PointIndices::Ptr &indices) {
+    if (!indices || !indices.unique()) {
+        indices.reset(new pcl::PointIndices);
+        return true;
+    }
+    indices->header = pcl::PCLHeader();
+    indices->indices.clear();
+    return false;
+}
+
+bool recycle(pcl::ModelCoefficients::Ptr &coefficients) {
+    if (!coefficients || !coefficients.unique()) {
+        coefficients.reset(new pcl::ModelCoefficients);
+        return true;
+    }
+    coefficients->header = pcl::PCLHeader();
+    coefficients->values.clear();
+    return false;
+}
+
+ScratchArena::ScratchArena() :
+        clouds_used_(0), indices_used_(0), coefficients_used_(0), allocations_(0) {}
+
+template<typename T>
+boost::shared_ptr<T> ScratchArena::lease(std::vector<Slot<T> > &slots, size_t &used) {
+    if (used == slots.size()) {
+        slots.push_back(Slot<T>());
+    }
+    Slot<T> &slot = slots[used++];
+    if (recycle(slot.buffer)) {
+        allocations_++;
+    }
+    slot.capacity = capacity(*slot.buffer);
+    return slot.buffer;
+}
+
+template<typename T>
+void ScratchArena::release(std::vector<Slot<T> > &slots, size_t &used) {
+    for (size_t i = 0; i < used; i++) {
+        if (capacity(*slots[i].buffer) > slots[i].capacity) {
+            allocations_++;
+        }
+    }
+    used = 0;
+}
+
+ScratchArena::CloudT::Ptr ScratchArena::cloud() {
+    return lease(clouds_, clouds_used_);
+}
+
+pcl::PointIndices::Ptr ScratchArena::indices() {
+    return lease(indices_, indices_used_);
+}
+
+pcl::ModelCoefficients::Ptr ScratchArena::coefficients() {
+    return lease(coefficients_, coefficients_used_);
+}
+
+void ScratchArena::reset() {
+    release(clouds_, clouds_used_);
+    release(indices_, indices_used_);
+    release(coefficients_, coefficients_used_);
+}
+
+uint64_t ScratchArena::takeAllocations() {
+    uint64_t allocations = allocations_;
+    allocations_ = 0;
+    return allocations;
+}
+
+}
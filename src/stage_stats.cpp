@@ -0,0 +1,52 @@
+#include <point_cloud_proc/stage_stats.h>
+
+namespace point_cloud_proc {
+
+const char *statsStageName(StatsStage stage) {
+    static const char *names[NUM_STATS_STAGES] = {
+            "transform", "crop", "voxel", "fused_filter", "ransac", "hull", "prism", "clustering",
+            "normals", "object_features", "serialization"
+    };
+    return stage >= 0 && stage < NUM_STATS_STAGES ? names[stage] : "unknown";
+}
+
+StageStats::StageStats() : enabled_(false) {
+    reset();
+}
+
+void StageStats::add(StatsStage stage, uint64_t ns, size_t points_in, size_t points_out) {
+    AtomicCounters &counters = counters_[stage];
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+    counters.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    counters.points_in.fetch_add(points_in, std::memory_order_relaxed);
+    counters.points_out.fetch_add(points_out, std::memory_order_relaxed);
+    uint64_t max_ns = counters.max_ns.load(std::memory_order_relaxed);
+    while (ns > max_ns && !counters.max_ns.compare_exchange_weak(max_ns, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void StageStats::get(PipelineStats &stats) const {
+    // Counters of a stage that is being updated may be off by one call
+    for (int i = 0; i < NUM_STATS_STAGES; i++) {
+        const AtomicCounters &counters = counters_[i];
+        StageCounters &out = stats.stages[i];
+        out.calls = counters.calls.load(std::memory_order_relaxed);
+        out.total_ns = counters.total_ns.load(std::memory_order_relaxed);
+        out.max_ns = counters.max_ns.load(std::memory_order_relaxed);
+        out.points_in = counters.points_in.load(std::memory_order_relaxed);
+        out.points_out = counters.points_out.load(std::memory_order_relaxed);
+    }
+}
+
+void StageStats::reset() {
+    for (int i = 0; i < NUM_STATS_STAGES; i++) {
+        AtomicCounters &counters = counters_[i];
+        counters.calls.store(0, std::memory_order_relaxed);
+        counters.total_ns.store(0, std::memory_order_relaxed);
+        counters.max_ns.store(0, std::memory_order_relaxed);
+        counters.points_in.store(0, std::memory_order_relaxed);
+        counters.points_out.store(0, std::memory_order_relaxed);
+    }
+}
+
+}
@@ -0,0 +1,187 @@
+#include <point_cloud_proc/voxel_hash_grid.h>
+
+#include <cmath>
+
+namespace point_cloud_proc {
+
+namespace {
+
+const size_t MIN_CAPACITY = 1024;
+
+// 21 bits per axis, enough for 2 km at 1 mm leaf size. Voxel coordinates
+// have to be in [-VOXEL_RANGE, VOXEL_RANGE), others would wrap onto another
+// voxel.
+const float VOXEL_RANGE = static_cast<float>(1 << 20);
+
+inline bool voxelInRange(float i) {
+    return i >= -VOXEL_RANGE && i < VOXEL_RANGE;
+}
+
+inline uint64_t voxelKey(int64_t i, int64_t j, int64_t k) {
+    const int64_t offset = 1 << 20;
+    return static_cast<uint64_t>(i + offset) << 42 |
+           static_cast<uint64_t>(j + offset) << 21 |
+           static_cast<uint64_t>(k + offset);
+}
+
+inline uint64_t hashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+}
+
+const uint32_t VoxelHashGrid::EMPTY_SLOT;
+
+bool voxelModeFromString(const std::string &name, VoxelMode &mode) {
+    if (name == "centroid") {
+        mode = VOXEL_CENTROID;
+    } else if (name == "first_point") {
+        mode = VOXEL_FIRST_POINT;
+    } else if (name == "color_average") {
+        mode = VOXEL_COLOR_AVERAGE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+VoxelHashGrid::VoxelHashGrid() :
+        leaf_size_(0.01f), inverse_leaf_size_(100.0f), mode_(VOXEL_COLOR_AVERAGE), mask_(0), dropped_(0) {
+    rehash(MIN_CAPACITY);
+}
+
+void VoxelHashGrid::setLeafSize(float leaf_size) {
+    leaf_size_ = leaf_size;
+    inverse_leaf_size_ = 1.0f / leaf_size;
+}
+
+void VoxelHashGrid::setMode(VoxelMode mode) {
+    mode_ = mode;
+}
+
+void VoxelHashGrid::clear() {
+    // Only the used slots are reset, the cost follows the last frame size
+    // and not the table capacity
+    for (const Voxel &voxel : voxels_) {
+        slots_[voxel.slot] = EMPTY_SLOT;
+    }
+    voxels_.clear();
+    dropped_ = 0;
+}
+
+size_t VoxelHashGrid::size() const {
+    return voxels_.size();
+}
+
+size_t VoxelHashGrid::dropped() const {
+    return dropped_;
+}
+
+bool VoxelHashGrid::addPoint(float x, float y, float z, uint32_t rgb) {
+
+    float i = std::floor(x * inverse_leaf_size_);
+    float j = std::floor(y * inverse_leaf_size_);
+    float k = std::floor(z * inverse_leaf_size_);
+    if (!voxelInRange(i) || !voxelInRange(j) || !voxelInRange(k)) {
+        dropped_++;
+        return false;
+    }
+    uint64_t key = voxelKey(static_cast<int64_t>(i), static_cast<int64_t>(j), static_cast<int64_t>(k));
+
+    size_t slot = hashKey(key) & mask_;
+    while (slots_[slot] != EMPTY_SLOT && keys_[slot] != key) {
+        slot = (slot + 1) & mask_;
+    }
+
+    if (slots_[slot] == EMPTY_SLOT) {
+        // Keep the load factor under 1/2 so probe sequences stay short
+        if (2 * (voxels_.size() + 1) > keys_.size()) {
+            rehash(2 * keys_.size());
+            slot = hashKey(key) & mask_;
+            while (slots_[slot] != EMPTY_SLOT) {
+                slot = (slot + 1) & mask_;
+            }
+        }
+        keys_[slot] = key;
+        slots_[slot] = static_cast<uint32_t>(voxels_.size());
+
+        Voxel voxel = {x, y, z, (rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff,
+                       rgb, 1, key, static_cast<uint32_t>(slot)};
+        voxels_.push_back(voxel);
+        return true;
+    }
+
+    Voxel &voxel = voxels_[slots_[slot]];
+    if (mode_ == VOXEL_FIRST_POINT) {
+        return true;
+    }
+    voxel.x += x;
+    voxel.y += y;
+    voxel.z += z;
+    voxel.r += (rgb >> 16) & 0xff;
+    voxel.g += (rgb >> 8) & 0xff;
+    voxel.b += rgb & 0xff;
+    voxel.count++;
+    return true;
+}
+
+void VoxelHashGrid::getCloud(CloudT &cloud_out) const {
+
+    cloud_out.points.resize(voxels_.size());
+    for (size_t i = 0; i < voxels_.size(); i++) {
+        const Voxel &voxel = voxels_[i];
+        PointT &p = cloud_out.points[i];
+        float inverse_count = 1.0f / voxel.count;
+        p.x = voxel.x * inverse_count;
+        p.y = voxel.y * inverse_count;
+        p.z = voxel.z * inverse_count;
+        if (mode_ == VOXEL_COLOR_AVERAGE) {
+            p.r = static_cast<uint8_t>(voxel.r / voxel.count);
+            p.g = static_cast<uint8_t>(voxel.g / voxel.count);
+            p.b = static_cast<uint8_t>(voxel.b / voxel.count);
+        } else {
+            p.r = (voxel.rgb >> 16) & 0xff;
+            p.g = (voxel.rgb >> 8) & 0xff;
+            p.b = voxel.rgb & 0xff;
+        }
+    }
+    cloud_out.width = cloud_out.points.size();
+    cloud_out.height = 1;
+    cloud_out.is_dense = true;
+}
+
+void VoxelHashGrid::filter(const CloudT &cloud_in, CloudT &cloud_out) {
+
+    clear();
+    for (const PointT &p : cloud_in.points) {
+        if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) {
+            uint32_t rgb = (static_cast<uint32_t>(p.r) << 16) | (static_cast<uint32_t>(p.g) << 8) | p.b;
+            addPoint(p.x, p.y, p.z, rgb);
+        }
+    }
+
+    cloud_out.header = cloud_in.header;
+    getCloud(cloud_out);
+}
+
+void VoxelHashGrid::rehash(size_t capacity) {
+
+    keys_.assign(capacity, 0);
+    slots_.assign(capacity, EMPTY_SLOT);
+    mask_ = capacity - 1;
+
+    for (size_t i = 0; i < voxels_.size(); i++) {
+        size_t slot = hashKey(voxels_[i].key) & mask_;
+        while (slots_[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask_;
+        }
+        keys_[slot] = voxels_[i].key;
+        slots_[slot] = static_cast<uint32_t>(i);
+        voxels_[i].slot = static_cast<uint32_t>(slot);
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#include <point_cloud_proc/diameter.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Scaling of the object diameter computation: pcl::getMaxSegment against the
+// hull and approximate methods on synthetic box shaped clusters of growing
+// size. Clusters larger than pcl_limit points skip getMaxSegment, the error
+// of the approximate method is then relative to the hull method.
+//
+// usage: bench_diameter [max_points] [max_error] [pcl_limit]
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+
+// Points on the surface of a box, like a cluster seen from all sides
+void makeCluster(size_t num_points, std::mt19937 &rng, CloudT &cloud) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.001f);
+    const float size[3] = {0.08f, 0.05f, 0.2f};
+
+    cloud.clear();
+    for (size_t i = 0; i < num_points; i++) {
+        int face = static_cast<int>(unit(rng) * 6.0f) % 6;
+        float p[3] = {unit(rng) * size[0], unit(rng) * size[1], unit(rng) * size[2]};
+        p[face / 2] = face % 2 ? size[face / 2] : 0.0f;
+
+        PointT point;
+        point.x = 0.6f + p[0] + noise(rng);
+        point.y = p[1] + noise(rng);
+        point.z = 0.7f + p[2] + noise(rng);
+        cloud.push_back(point);
+    }
+}
+
+double timeMs(const CloudT &cloud, point_cloud_proc::DiameterMethod method, float max_error, double &diameter) {
+    PointT pmin, pmax;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    diameter = point_cloud_proc::computeDiameter(cloud, method, pmin, pmax, max_error);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+
+    size_t max_points = argc > 1 ? std::stoul(argv[1]) : 25000;
+    float max_error = argc > 2 ? std::stof(argv[2]) : 0.01f;
+    size_t pcl_limit = argc > 3 ? std::stoul(argv[3]) : 25000;
+
+    std::mt19937 rng(42);
+    CloudT cloud;
+
+    std::cout << "points, pcl ms, hull ms, approx ms, approx rel error" << std::endl;
+    for (size_t num_points = 250; num_points <= max_points; num_points *= 2) {
+        makeCluster(num_points, rng, cloud);
+
+        double pcl_diameter = 0.0, hull_diameter = 0.0, approx_diameter = 0.0;
+        double pcl_ms = -1.0;
+        if (num_points <= pcl_limit) {
+            pcl_ms = timeMs(cloud, point_cloud_proc::DIAMETER_PCL, max_error, pcl_diameter);
+        }
+        double hull_ms = timeMs(cloud, point_cloud_proc::DIAMETER_HULL, max_error, hull_diameter);
+        double approx_ms = timeMs(cloud, point_cloud_proc::DIAMETER_APPROX, max_error, approx_diameter);
+
+        if (pcl_ms >= 0.0 && std::abs(pcl_diameter - hull_diameter) > 1e-6) {
+            std::cout << "hull diameter " << hull_diameter << " differs from pcl " << pcl_diameter << std::endl;
+        }
+
+        std::cout << num_points << ", " << pcl_ms << ", " << hull_ms << ", " << approx_ms << ", "
+                  << 1.0 - approx_diameter / hull_diameter << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <point_cloud_proc/fused_filter.h>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/common/transforms.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <yaml-cpp/yaml.h>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+// Compares the PCL front end (fromROSMsg, transform, 3 pass-throughs and a
+// voxel grid) with the fused single pass filter on recorded frames.
+//
+// usage: bench_front_end config.yaml [--tf x y z qx qy qz qw] [--iterations n] frame.pcd ...
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void pclFrontEnd(const sensor_msgs::PointCloud2 &cloud_ros, const Eigen::Affine3f &transform,
+                 const std::vector<float> &limits, float leaf_size, CloudT &cloud_out) {
+    CloudT::Ptr cloud_in(new CloudT);
+    CloudT::Ptr cloud_filtered(new CloudT);
+    pcl::PassThrough<PointT> pass;
+    pcl::VoxelGrid<PointT> vg;
+
+    pcl::fromROSMsg(cloud_ros, *cloud_in);
+    pcl::transformPointCloud(*cloud_in, *cloud_filtered, transform);
+
+    const char *fields[] = {"x", "y", "z"};
+    for (int i = 0; i < 3; i++) {
+        pass.setInputCloud(cloud_filtered);
+        pass.setFilterFieldName(fields[i]);
+        pass.setFilterLimits(limits[2 * i], limits[2 * i + 1]);
+        pass.filter(*cloud_filtered);
+    }
+
+    vg.setInputCloud(cloud_filtered);
+    vg.setLeafSize(leaf_size, leaf_size, leaf_size);
+    vg.filter(cloud_out);
+}
+
+float maxDeviation(const CloudT::Ptr &reference, const CloudT &cloud) {
+    if (reference->empty()) {
+        return cloud.empty() ? 0.0f : std::numeric_limits<float>::infinity();
+    }
+    pcl::KdTreeFLANN<PointT> tree;
+    tree.setInputCloud(reference);
+    std::vector<int> index(1);
+    std::vector<float> sqr_dist(1);
+    float max_dist = 0.0f;
+    for (const PointT &p : cloud.points) {
+        tree.nearestKSearch(p, 1, index, sqr_dist);
+        max_dist = std::max(max_dist, std::sqrt(sqr_dist[0]));
+    }
+    return max_dist;
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 3) {
+        std::cout << "usage: bench_front_end config.yaml [--tf x y z qx qy qz qw] "
+                     "[--iterations n] frame.pcd ..." << std::endl;
+        return 1;
+    }
+
+    YAML::Node parameters = YAML::LoadFile(argv[1]);
+    std::vector<float> limits = parameters["filters"]["pass_limits"].as<std::vector<float>>();
+    float leaf_size = parameters["filters"]["leaf_size"].as<float>();
+
+    Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+    int iterations = 20;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tf" && i + 7 < argc) {
+            float v[7];
+            for (int j = 0; j < 7; j++) {
+                v[j] = std::stof(argv[++i]);
+            }
+            transform = Eigen::Translation3f(v[0], v[1], v[2]) * Eigen::Quaternionf(v[6], v[3], v[4], v[5]);
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoi(argv[++i]);
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    point_cloud_proc::FusedFilter fused;
+    fused.setTransform(transform);
+    fused.setLimits(limits);
+    fused.setLeafSize(leaf_size);
+
+    double pcl_total = 0.0, fused_total = 0.0;
+    int frames = 0;
+    for (const std::string &file : files) {
+        pcl::PCLPointCloud2 cloud_pcl;
+        if (pcl::io::loadPCDFile(file, cloud_pcl) < 0) {
+            std::cout << "couldn't load " << file << std::endl;
+            continue;
+        }
+        sensor_msgs::PointCloud2 cloud_ros;
+        pcl_conversions::fromPCL(cloud_pcl, cloud_ros);
+
+        CloudT::Ptr pcl_out(new CloudT);
+        CloudT fused_out;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            pclFrontEnd(cloud_ros, transform, limits, leaf_size, *pcl_out);
+            pcl_total += elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            fused.filter(cloud_ros, fused_out);
+            fused_total += elapsedMs(start);
+        }
+        frames += iterations;
+
+        std::cout << file << ": pcl " << pcl_out->size() << " points, fused " << fused_out.size()
+                  << " points, max deviation " << maxDeviation(pcl_out, fused_out) << " m" << std::endl;
+    }
+
+    if (frames == 0) {
+        return 1;
+    }
+
+    std::cout << "pcl front end:   " << pcl_total / frames << " ms/frame" << std::endl;
+    std::cout << "fused front end: " << fused_total / frames << " ms/frame" << std::endl;
+    std::cout << "speedup:         " << pcl_total / fused_total << "x" << std::endl;
+
+    return 0;
+}
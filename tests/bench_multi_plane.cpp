@@ -0,0 +1,83 @@
+#include <ros/ros.h>
+#include <point_cloud_proc/point_cloud_proc.h>
+
+#include <random>
+
+// Regression benchmark for segmentMultiplePlane(): synthetic scenes with 1 to
+// max_planes horizontal shelves are fed through pointCloudCb() and the time
+// per call is reported for each number of planes. The scene is generated in
+// the fixed frame so no TF is needed, frame_max_age_ms in the config has to be
+// larger than 0 so the injected frame is used right away.
+//
+// usage: bench_multi_plane [config.yaml] [iterations] [max_planes]
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> CloudT;
+
+sensor_msgs::PointCloud2::Ptr makeScene(int num_planes, const std::string &frame_id) {
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+
+    CloudT cloud;
+    for (int i = 0; i < num_planes; i++) {
+        float height = 0.2f + 0.3f * i;
+        for (float x = 0.3f; x < 1.1f; x += 0.005f) {
+            for (float y = -0.4f; y < 0.4f; y += 0.005f) {
+                pcl::PointXYZRGB p;
+                p.x = x;
+                p.y = y;
+                p.z = height + noise(rng);
+                p.r = p.g = p.b = 128;
+                cloud.push_back(p);
+            }
+        }
+    }
+
+    sensor_msgs::PointCloud2::Ptr msg(new sensor_msgs::PointCloud2);
+    pcl::toROSMsg(cloud, *msg);
+    msg->header.frame_id = frame_id;
+    return msg;
+}
+
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "bench_multi_plane");
+    ros::NodeHandle nh;
+
+    std::string config = argc > 1 ? argv[1] : ros::package::getPath("point_cloud_proc") + "/config/default.yaml";
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    int max_planes = argc > 3 ? std::stoi(argv[3]) : 6;
+
+    YAML::Node parameters = YAML::LoadFile(config);
+    std::string fixed_frame = parameters["fixed_frame"].as<std::string>();
+    if (parameters["frame_max_age_ms"].as<double>(0.0) <= 0.0) {
+        std::cout << "frame_max_age_ms has to be larger than 0 for this benchmark" << std::endl;
+        return 1;
+    }
+
+    PointCloudProc pcp(nh, false, config);
+
+    std::cout << "planes, found, mean ms, max ms" << std::endl;
+    for (int num_planes = 1; num_planes <= max_planes; num_planes++) {
+        sensor_msgs::PointCloud2::Ptr msg = makeScene(num_planes, fixed_frame);
+
+        double total = 0.0, worst = 0.0;
+        size_t found = 0;
+        for (int i = 0; i < iterations; i++) {
+            msg->header.stamp = ros::Time::now();
+            pcp.pointCloudCb(msg);
+
+            std::vector<point_cloud_proc::Plane> planes;
+            ros::WallTime start = ros::WallTime::now();
+            pcp.segmentMultiplePlane(planes);
+            double elapsed = (ros::WallTime::now() - start).toSec() * 1000.0;
+
+            total += elapsed;
+            worst = std::max(worst, elapsed);
+            found = planes.size();
+        }
+
+        std::cout << num_planes << ", " << found << ", " << total / iterations << ", " << worst << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+#include <ros/ros.h>
+#include <point_cloud_proc/point_cloud_proc.h>
+#include <point_cloud_proc/latency_stats.h>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include <dirent.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+// Replays recorded frames through an offline PointCloudProc, no ROS master or
+// sensor needed. Frames come from a directory of PCD files or from a rosbag
+// with the point_cloud_topic of the config and /tf, /tf_static. Every frame
+// runs through transformPointCloud, filterPointCloud, segmentSinglePlane,
+// extractTabletop, segmentMultiplePlane and clusterObjects, each call is
+// timed on its own and a whole frame as "frame". The report is JSON with
+// p50/p95/p99 latency and throughput per stage, the peak RSS of the process
+// and the allocations per frame. The first frame warms up the scratch
+// buffers, the steady state counts start after it.
+//
+// PCD frames are in the fixed frame, or in a sensor frame placed by --tf.
+//
+// usage: bench_replay config.yaml [--tf x y z qx qy qz qw] [--topic name] [--iterations n]
+//                     [--max-frames n] [--output report.json] (pcd_dir | recording.bag)
+
+typedef pcl::PointCloud<pcl::PointXYZRGB> CloudT;
+
+// Every heap allocation of the process
+std::atomic<uint64_t> heap_allocations(0);
+
+void *operator new(size_t size) {
+    heap_allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+const char *STAGE_NAMES[] = {"transform", "filter", "single_plane", "extract_tabletop", "multi_plane",
+                             "cluster", "frame"};
+const int NUM_STAGES = sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]);
+
+struct StageResult {
+    point_cloud_proc::LatencyStats stats;
+    uint64_t succeeded = 0;
+    double total_ms = 0.0;
+
+    void add(double ms, bool success) {
+        stats.add(ms);
+        total_ms += ms;
+        succeeded += success;
+    }
+};
+
+double elapsedMs(const ros::WallTime &start) {
+    return (ros::WallTime::now() - start).toSec() * 1000.0;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string bareTopic(const std::string &topic) {
+    return !topic.empty() && topic[0] == '/' ? topic.substr(1) : topic;
+}
+
+std::string jsonString(const std::string &s) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+bool loadPcdDirectory(const std::string &path, const std::string &frame_id, size_t max_frames,
+                      std::vector<sensor_msgs::PointCloud2::ConstPtr> &frames) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+        return false;
+    }
+    std::vector<std::string> files;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (endsWith(name, ".pcd")) {
+            files.push_back(path + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+
+    for (const std::string &file : files) {
+        if (max_frames > 0 && frames.size() >= max_frames) {
+            break;
+        }
+        pcl::PCLPointCloud2 cloud_pcl;
+        if (pcl::io::loadPCDFile(file, cloud_pcl) < 0) {
+            std::cerr << "couldn't load " << file << std::endl;
+            continue;
+        }
+        sensor_msgs::PointCloud2::Ptr msg(new sensor_msgs::PointCloud2);
+        pcl_conversions::fromPCL(cloud_pcl, *msg);
+        msg->header.frame_id = frame_id;
+        msg->header.stamp = ros::Time(1.0 + frames.size() / 30.0);
+        frames.push_back(msg);
+    }
+    return true;
+}
+
+// TF of the whole bag is kept, so the buffer has to cover its duration
+bool loadBag(const std::string &path, const std::string &topic, size_t max_frames,
+             std::vector<sensor_msgs::PointCloud2::ConstPtr> &frames,
+             std::vector<geometry_msgs::TransformStamped> &transforms,
+             std::vector<geometry_msgs::TransformStamped> &static_transforms, ros::Duration &duration) {
+    rosbag::Bag bag;
+    try {
+        bag.open(path, rosbag::bagmode::Read);
+    } catch (rosbag::BagException &ex) {
+        std::cerr << ex.what() << std::endl;
+        return false;
+    }
+
+    // Topics are recorded with or without the leading slash
+    const std::string cloud_topic = bareTopic(topic);
+    std::vector<std::string> topics;
+    const char *names[] = {cloud_topic.c_str(), "tf", "tf_static"};
+    for (const char *name : names) {
+        topics.push_back(name);
+        topics.push_back(std::string("/") + name);
+    }
+    rosbag::View view(bag, rosbag::TopicQuery(topics));
+    duration = view.getEndTime() - view.getBeginTime();
+
+    for (const rosbag::MessageInstance &m : view) {
+        if (bareTopic(m.getTopic()) == cloud_topic) {
+            sensor_msgs::PointCloud2::ConstPtr cloud = m.instantiate<sensor_msgs::PointCloud2>();
+            if (cloud && (max_frames == 0 || frames.size() < max_frames)) {
+                frames.push_back(cloud);
+            }
+            continue;
+        }
+        tf2_msgs::TFMessage::ConstPtr tf = m.instantiate<tf2_msgs::TFMessage>();
+        if (tf) {
+            std::vector<geometry_msgs::TransformStamped> &out =
+                    bareTopic(m.getTopic()) == "tf_static" ? static_transforms : transforms;
+            out.insert(out.end(), tf->transforms.begin(), tf->transforms.end());
+        }
+    }
+    bag.close();
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 3) {
+        std::cout << "usage: bench_replay config.yaml [--tf x y z qx qy qz qw] [--topic name] "
+                     "[--iterations n] [--max-frames n] [--output report.json] (pcd_dir | recording.bag)"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string config = argv[1];
+    YAML::Node parameters = YAML::LoadFile(config);
+    std::string fixed_frame = parameters["fixed_frame"].as<std::string>();
+    std::string topic = parameters["point_cloud_topic"].as<std::string>();
+
+    bool sensor_tf = false;
+    geometry_msgs::TransformStamped sensor_transform;
+    sensor_transform.transform.rotation.w = 1.0;
+    int iterations = 1;
+    size_t max_frames = 0;
+    std::string output, source;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tf" && i + 7 < argc) {
+            geometry_msgs::Transform &t = sensor_transform.transform;
+            t.translation.x = std::stod(argv[++i]);
+            t.translation.y = std::stod(argv[++i]);
+            t.translation.z = std::stod(argv[++i]);
+            t.rotation.x = std::stod(argv[++i]);
+            t.rotation.y = std::stod(argv[++i]);
+            t.rotation.z = std::stod(argv[++i]);
+            t.rotation.w = std::stod(argv[++i]);
+            sensor_tf = true;
+        } else if (arg == "--topic" && i + 1 < argc) {
+            topic = argv[++i];
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--max-frames" && i + 1 < argc) {
+            max_frames = static_cast<size_t>(std::max(0, std::stoi(argv[++i])));
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            source = arg;
+        }
+    }
+
+    std::vector<sensor_msgs::PointCloud2::ConstPtr> frames;
+    std::vector<geometry_msgs::TransformStamped> transforms, static_transforms;
+    ros::Duration duration(0.0);
+    bool loaded;
+    if (endsWith(source, ".bag")) {
+        loaded = loadBag(source, topic, max_frames, frames, transforms, static_transforms, duration);
+    } else {
+        sensor_transform.header.frame_id = fixed_frame;
+        sensor_transform.child_frame_id = "replay_sensor";
+        if (sensor_tf) {
+            static_transforms.push_back(sensor_transform);
+        }
+        loaded = loadPcdDirectory(source, sensor_tf ? sensor_transform.child_frame_id : fixed_frame,
+                                  max_frames, frames);
+    }
+    if (!loaded || frames.empty()) {
+        std::cerr << "no frames in " << source << std::endl;
+        return 1;
+    }
+
+    // PCP logs to std::cout, stdout is kept for the report
+    std::streambuf *stdout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+
+    PointCloudProc pcp(config, duration + ros::Duration(10.0));
+    for (const geometry_msgs::TransformStamped &t : static_transforms) {
+        pcp.setTransform(t, true);
+    }
+    for (const geometry_msgs::TransformStamped &t : transforms) {
+        pcp.setTransform(t);
+    }
+
+    std::vector<StageResult> results(NUM_STAGES);
+    uint64_t warm_scratch = 0, warm_heap = 0;
+    size_t frame_count = 0;
+    ros::WallTime bench_start = ros::WallTime::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (const sensor_msgs::PointCloud2::ConstPtr &msg : frames) {
+            if (frame_count++ == 1) {
+                warm_scratch = pcp.getFrameStats().scratch_allocations;
+                warm_heap = heap_allocations;
+            }
+            pcp.pointCloudCb(msg);
+
+            point_cloud_proc::Plane plane;
+            std::vector<point_cloud_proc::Plane> planes;
+            std::vector<point_cloud_proc::Object> objects;
+            bool success[NUM_STAGES];
+            double ms[NUM_STAGES];
+            ros::WallTime frame_start = ros::WallTime::now(), start = frame_start;
+
+            success[0] = pcp.transformPointCloud();
+            ms[0] = elapsedMs(start);
+            start = ros::WallTime::now();
+            success[1] = pcp.filterPointCloud();
+            ms[1] = elapsedMs(start);
+            start = ros::WallTime::now();
+            success[2] = pcp.segmentSinglePlane(plane);
+            ms[2] = elapsedMs(start);
+            // Extracts from the frame of segmentSinglePlane
+            start = ros::WallTime::now();
+            success[3] = pcp.extractTabletop();
+            ms[3] = elapsedMs(start);
+            start = ros::WallTime::now();
+            success[4] = pcp.segmentMultiplePlane(planes);
+            ms[4] = elapsedMs(start);
+            start = ros::WallTime::now();
+            success[5] = pcp.clusterObjects(objects);
+            ms[5] = elapsedMs(start);
+            success[6] = success[5];
+            ms[6] = elapsedMs(frame_start);
+
+            for (int s = 0; s < NUM_STAGES; s++) {
+                results[s].add(ms[s], success[s]);
+            }
+        }
+    }
+    double wall_time = (ros::WallTime::now() - bench_start).toSec();
+    uint64_t scratch_allocations = pcp.getFrameStats().scratch_allocations;
+    uint64_t steady_heap = frame_count > 1 ? heap_allocations - warm_heap : 0;
+
+    std::cout.rdbuf(stdout_buf);
+
+    // ru_maxrss is in kilobytes on Linux
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    size_t processed = frames.size() * iterations;
+    std::ostringstream report;
+    report << "{\n";
+    report << "  \"config\": " << jsonString(config) << ",\n";
+    report << "  \"source\": " << jsonString(source) << ",\n";
+    report << "  \"frames\": " << frames.size() << ",\n";
+    report << "  \"iterations\": " << iterations << ",\n";
+    report << "  \"wall_time_s\": " << wall_time << ",\n";
+    report << "  \"throughput_fps\": " << processed / wall_time << ",\n";
+    report << "  \"peak_rss_kb\": " << usage.ru_maxrss << ",\n";
+    report << "  \"scratch_allocations\": {\"total\": " << scratch_allocations
+           << ", \"steady_state\": " << (frame_count > 1 ? scratch_allocations - warm_scratch : 0) << "},\n";
+    report << "  \"heap_allocations_per_frame\": "
+           << (frame_count > 1 ? static_cast<double>(steady_heap) / (frame_count - 1) : 0.0) << ",\n";
+    report << "  \"stages\": {\n";
+    for (int s = 0; s < NUM_STAGES; s++) {
+        point_cloud_proc::LatencySummary summary = results[s].stats.summary();
+        report << "    " << jsonString(STAGE_NAMES[s]) << ": {"
+               << "\"calls\": " << summary.count
+               << ", \"succeeded\": " << results[s].succeeded
+               << ", \"mean_ms\": " << summary.mean_ms
+               << ", \"p50_ms\": " << summary.p50_ms
+               << ", \"p95_ms\": " << summary.p95_ms
+               << ", \"p99_ms\": " << summary.p99_ms
+               << ", \"max_ms\": " << summary.max_ms
+               << ", \"throughput_hz\": " << (results[s].total_ms > 0.0 ? 1000.0 * summary.count / results[s].total_ms : 0.0)
+               << "}" << (s + 1 < NUM_STAGES ? "," : "") << "\n";
+    }
+    report << "  }\n";
+    report << "}\n";
+
+    if (output.empty()) {
+        std::cout << report.str();
+    } else {
+        std::ofstream file(output.c_str());
+        file << report.str();
+        if (!file) {
+            std::cerr << "couldn't write " << output << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
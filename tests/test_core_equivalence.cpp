@@ -0,0 +1,224 @@
+#include <point_cloud_proc/scene_segmenter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// The replacements of the PCL algorithms against the originals on synthetic
+// tabletop scenes: the monotone chain hull against pcl::ConvexHull, the
+// raster prism against pcl::ExtractPolygonalPrismData and GridClustering
+// against pcl::EuclideanClusterExtraction, each through SceneSegmenter like
+// the node runs them. Hull areas have to match and prisms and clusters have
+// to pick the same points. A prism point may only differ when it lies on the
+// hull boundary or the height limits within the tolerance below, where the
+// float rounding of the two implementations decides.
+//
+// usage: test_core_equivalence [num_scenes] [seed]
+// Returns non zero when a scene differs.
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+
+const float kTableZ = 0.7f;
+const float kBoundaryTolerance = 1e-4f;
+
+void addPoint(CloudT &cloud, float x, float y, float z) {
+    PointT point;
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    cloud.push_back(point);
+}
+
+// Points on the surface of a box with its lower corner at (x, y, z)
+void addBox(CloudT &cloud, float x, float y, float z, const float size[3], size_t num_points, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < num_points; i++) {
+        int face = static_cast<int>(unit(rng) * 6.0f) % 6;
+        float p[3] = {unit(rng) * size[0], unit(rng) * size[1], unit(rng) * size[2]};
+        p[face / 2] = face % 2 ? size[face / 2] : 0.0f;
+        addPoint(cloud, x + p[0], y + p[1], z + p[2]);
+    }
+}
+
+// A noisy table top, boxes on it, one over its edge and two closer than the
+// cluster tolerance, and clutter below and above the prism. The table points
+// come first, table gets their indices.
+void makeScene(std::mt19937 &rng, CloudT &cloud, std::vector<int> &table) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+
+    cloud.clear();
+    table.clear();
+    float width = 0.6f + 0.4f * unit(rng), depth = 0.5f + 0.3f * unit(rng);
+    for (int i = 0; i < 20000; i++) {
+        table.push_back(static_cast<int>(cloud.points.size()));
+        addPoint(cloud, 0.4f + width * unit(rng), -0.5f * depth + depth * unit(rng), kTableZ + noise(rng));
+    }
+
+    const float small[3] = {0.06f, 0.06f, 0.12f};
+    const float large[3] = {0.1f, 0.2f, 0.18f};
+    for (int i = 0; i < 4; i++) {
+        addBox(cloud, 0.45f + (width - 0.15f) * unit(rng), -0.4f * depth + 0.7f * depth * unit(rng),
+               kTableZ + 0.01f, small, 600, rng);
+    }
+    addBox(cloud, 0.35f + width, -0.1f, kTableZ + 0.01f, large, 1500, rng);
+    addBox(cloud, 0.5f, 0.0f, kTableZ + 0.01f, small, 600, rng);
+    addBox(cloud, 0.56f + 0.02f * unit(rng), 0.0f, kTableZ + 0.01f, small, 600, rng);
+
+    for (int i = 0; i < 3000; i++) {
+        addPoint(cloud, 0.2f + 1.4f * unit(rng), -0.8f + 1.6f * unit(rng), 1.5f * unit(rng));
+    }
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+double polygonArea(const CloudT &hull) {
+    double area = 0.0;
+    for (size_t i = 0, j = hull.points.size() - 1; i < hull.points.size(); j = i++) {
+        area += hull.points[j].x * hull.points[i].y - hull.points[i].x * hull.points[j].y;
+    }
+    return std::abs(area) / 2.0;
+}
+
+// Distance in the table plane from p to the nearest edge of hull
+float boundaryDistance(const CloudT &hull, const PointT &p) {
+    float distance = std::numeric_limits<float>::max();
+    for (size_t i = 0, j = hull.points.size() - 1; i < hull.points.size(); j = i++) {
+        Eigen::Vector2f a(hull.points[j].x, hull.points[j].y), b(hull.points[i].x, hull.points[i].y);
+        Eigen::Vector2f q(p.x, p.y);
+        float t = std::max(0.0f, std::min(1.0f, (q - a).dot(b - a) / (b - a).squaredNorm()));
+        distance = std::min(distance, (a + t * (b - a) - q).norm());
+    }
+    return distance;
+}
+
+bool onLimit(const PointT &p, const std::vector<float> &limits) {
+    // The viewpoint is below the table, heights above it are negative
+    float height = kTableZ - p.z;
+    return std::abs(height - limits[0]) <= kBoundaryTolerance || std::abs(height - limits[1]) <= kBoundaryTolerance;
+}
+
+bool compareHulls(const CloudT &hull_pcl, const CloudT &hull_monotone) {
+    double area_pcl = polygonArea(hull_pcl), area_monotone = polygonArea(hull_monotone);
+    if (std::abs(area_pcl - area_monotone) > 1e-6 * area_pcl) {
+        std::cout << "  hull area " << area_monotone << " differs from pcl " << area_pcl << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool comparePrisms(const CloudT &cloud, const CloudT &hull, const std::vector<float> &limits,
+                   const std::vector<int> &inside_pcl, const std::vector<int> &inside_raster) {
+    std::vector<int> differing;
+    std::set_symmetric_difference(inside_pcl.begin(), inside_pcl.end(), inside_raster.begin(), inside_raster.end(),
+                                  std::back_inserter(differing));
+    size_t unexplained = 0;
+    for (int index : differing) {
+        const PointT &p = cloud.points[index];
+        if (boundaryDistance(hull, p) > kBoundaryTolerance && !onLimit(p, limits)) {
+            unexplained++;
+        }
+    }
+    if (unexplained > 0) {
+        std::cout << "  prism: " << unexplained << " of " << inside_pcl.size() << " points differ from pcl"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void sortClusters(std::vector<pcl::PointIndices> &clusters) {
+    for (pcl::PointIndices &cluster : clusters) {
+        std::sort(cluster.indices.begin(), cluster.indices.end());
+    }
+    // Clusters of the same size may come in any order
+    std::sort(clusters.begin(), clusters.end(), [](const pcl::PointIndices &a, const pcl::PointIndices &b) {
+        return a.indices.front() < b.indices.front();
+    });
+}
+
+bool compareClusters(std::vector<pcl::PointIndices> &clusters_kdtree, std::vector<pcl::PointIndices> &clusters_grid) {
+    sortClusters(clusters_kdtree);
+    sortClusters(clusters_grid);
+    if (clusters_kdtree.size() != clusters_grid.size()) {
+        std::cout << "  " << clusters_grid.size() << " grid clusters, " << clusters_kdtree.size() << " kdtree clusters"
+                  << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < clusters_kdtree.size(); i++) {
+        if (clusters_kdtree[i].indices != clusters_grid[i].indices) {
+            std::cout << "  cluster " << i << " differs, " << clusters_grid[i].indices.size() << " grid points, "
+                      << clusters_kdtree[i].indices.size() << " kdtree points" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    int num_scenes = argc > 1 ? std::stoi(argv[1]) : 20;
+    unsigned int seed = argc > 2 ? std::stoul(argv[2]) : 42;
+
+    point_cloud_proc::SegmenterParams pcl_params;
+    pcl_params.prism_limits[0] = -0.25f;
+    pcl_params.prism_limits[1] = -0.02f;
+    pcl_params.cluster_tol = 0.03f;
+    pcl_params.min_cluster_size = 50;
+    pcl_params.max_cluster_size = 25000;
+    pcl_params.monotone_hull = false;
+    pcl_params.cluster_method = point_cloud_proc::CLUSTER_KDTREE;
+
+    point_cloud_proc::SegmenterParams new_params = pcl_params;
+    new_params.monotone_hull = true;
+    new_params.cluster_method = point_cloud_proc::CLUSTER_GRID;
+
+    point_cloud_proc::SceneSegmenter pcl_segmenter(pcl_params), new_segmenter(new_params);
+
+    pcl::ModelCoefficients coefficients;
+    coefficients.values = {0.0f, 0.0f, 1.0f, -kTableZ};
+
+    std::mt19937 rng(seed);
+    CloudT::Ptr cloud(new CloudT);
+    CloudT::Ptr hull_pcl(new CloudT), hull_monotone(new CloudT);
+    pcl::PointIndices::Ptr inside_pcl(new pcl::PointIndices), inside_raster(new pcl::PointIndices);
+    std::vector<int> table;
+    int failed = 0;
+
+    for (int scene = 0; scene < num_scenes; scene++) {
+        makeScene(rng, *cloud, table);
+
+        pcl_segmenter.computeHull(cloud, &table, coefficients, *hull_pcl);
+        new_segmenter.computeHull(cloud, &table, coefficients, *hull_monotone);
+        bool hull_ok = compareHulls(*hull_pcl, *hull_monotone);
+
+        // Both prisms over the same hull, so only the prism test differs
+        pcl_segmenter.segmentPrism(cloud, pcl::PointIndices::Ptr(), hull_pcl, *inside_pcl);
+        new_segmenter.segmentPrism(cloud, pcl::PointIndices::Ptr(), hull_pcl, *inside_raster);
+        std::sort(inside_pcl->indices.begin(), inside_pcl->indices.end());
+        std::sort(inside_raster->indices.begin(), inside_raster->indices.end());
+        bool prism_ok = comparePrisms(*cloud, *hull_pcl, pcl_params.prism_limits,
+                                      inside_pcl->indices, inside_raster->indices);
+
+        std::vector<pcl::PointIndices> clusters_kdtree, clusters_grid;
+        pcl_segmenter.cluster(cloud, inside_pcl, clusters_kdtree);
+        new_segmenter.cluster(cloud, inside_pcl, clusters_grid);
+        bool clusters_ok = compareClusters(clusters_kdtree, clusters_grid);
+
+        std::cout << "scene " << scene << ": hull " << (hull_ok ? "ok" : "FAILED")
+                  << ", prism " << (prism_ok ? "ok" : "FAILED")
+                  << ", clusters " << (clusters_ok ? "ok" : "FAILED") << std::endl;
+        if (!hull_ok || !prism_ok || !clusters_ok) {
+            failed++;
+        }
+    }
+
+    std::cout << failed << " of " << num_scenes << " scenes differ" << std::endl;
+    return failed > 0 ? 1 : 0;
+}
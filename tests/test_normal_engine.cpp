@@ -0,0 +1,237 @@
+#include <point_cloud_proc/normal_engine.h>
+#include <pcl/common/io.h>
+#include <pcl/features/normal_3d.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// NormalEngine on the points in indices of a larger cloud against
+// pcl::NormalEstimation on the same points extracted into their own cloud,
+// the way the tabletop normals were estimated before clusterTabletop()
+// passed views. The neighbourhoods must only reach points in indices, so
+// both have to give the same normals. The tabletop is a set of boxes
+// standing on a table, the table points around them are in the cloud but
+// not in indices. The same runs on an organized cloud with NaN pixels,
+// where the indices are the clustered pixels like on the organized path of
+// clusterTabletop(). Calls from the same source have to hit the cache of the
+// engine unless the index contents change, and normals handed out must stay
+// intact when the engine recomputes.
+//
+// usage: test_normal_engine [num_scenes] [seed]
+// Returns non zero when a normal differs.
+
+typedef pcl::PointXYZRGB PointT;
+typedef pcl::PointCloud<PointT> CloudT;
+typedef pcl::PointCloud<pcl::Normal> CloudNT;
+
+const float kTableZ = 0.7f;
+const int kSearch = 50;
+
+// Points with a flag that tells whether they are on the tabletop
+typedef std::vector<std::pair<PointT, bool> > ScenePoints;
+
+void addPoint(ScenePoints &points, float x, float y, float z, bool tabletop) {
+    PointT point;
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    points.push_back(std::make_pair(point, tabletop));
+}
+
+// Points on the surface of a box standing on the table
+void addBox(ScenePoints &points, float x, float y, const float size[3], size_t num_points, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < num_points; i++) {
+        // No bottom face, the box stands on the table
+        int face = 1 + static_cast<int>(unit(rng) * 5.0f) % 5;
+        float p[3] = {unit(rng) * size[0], unit(rng) * size[1], unit(rng) * size[2]};
+        p[face / 2] = face % 2 ? size[face / 2] : 0.0f;
+        addPoint(points, x + p[0], y + p[1], kTableZ + 0.005f + p[2], true);
+    }
+}
+
+// A table with boxes on it and clutter around, tabletop gets the indices of
+// the box points
+void makeScene(std::mt19937 &rng, CloudT &cloud, std::vector<int> &tabletop) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+
+    ScenePoints points;
+    for (int i = 0; i < 15000; i++) {
+        addPoint(points, 0.4f + 0.8f * unit(rng), -0.4f + 0.8f * unit(rng), kTableZ + noise(rng), false);
+    }
+    const float size[3] = {0.06f, 0.08f, 0.12f};
+    for (int i = 0; i < 4; i++) {
+        addBox(points, 0.45f + 0.6f * unit(rng), -0.35f + 0.6f * unit(rng), size, 800, rng);
+    }
+    for (int i = 0; i < 2000; i++) {
+        addPoint(points, 0.2f + 1.4f * unit(rng), -0.8f + 1.6f * unit(rng), 1.5f * unit(rng), false);
+    }
+
+    // Table, box and clutter points are interleaved in memory like in a
+    // voxelized frame
+    std::shuffle(points.begin(), points.end(), rng);
+    cloud.clear();
+    tabletop.clear();
+    for (size_t i = 0; i < points.size(); i++) {
+        cloud.push_back(points[i].first);
+        if (points[i].second) {
+            tabletop.push_back(static_cast<int>(i));
+        }
+    }
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+// The points of cloud in an organized cloud, row by row with NaN pixels
+// between them, indices are mapped to their pixels
+void makeOrganized(const CloudT &cloud, std::vector<int> &indices, CloudT &organized) {
+    const uint32_t width = 160;
+    PointT invalid;
+    invalid.x = invalid.y = invalid.z = std::numeric_limits<float>::quiet_NaN();
+
+    std::vector<int> pixels(cloud.points.size());
+    organized.clear();
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+        if (i % 7 == 0) {
+            organized.push_back(invalid);
+        }
+        pixels[i] = static_cast<int>(organized.points.size());
+        organized.push_back(cloud.points[i]);
+    }
+    while (organized.points.size() % width != 0) {
+        organized.push_back(invalid);
+    }
+    organized.width = width;
+    organized.height = organized.points.size() / width;
+    organized.is_dense = false;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = pixels[indices[i]];
+    }
+}
+
+bool sameNormal(const pcl::Normal &a, const pcl::Normal &b) {
+    if (!std::isfinite(a.normal_x) || !std::isfinite(b.normal_x)) {
+        return std::isfinite(a.normal_x) == std::isfinite(b.normal_x);
+    }
+    const float tolerance = 1e-4f;
+    return std::abs(a.normal_x - b.normal_x) <= tolerance && std::abs(a.normal_y - b.normal_y) <= tolerance &&
+           std::abs(a.normal_z - b.normal_z) <= tolerance && std::abs(a.curvature - b.curvature) <= tolerance;
+}
+
+// Normals of the points in indices of cloud by the engine against
+// pcl::NormalEstimation on the extracted points, returns the number of
+// points that differ
+size_t compareToExtracted(const CloudNT &normals, const CloudT::Ptr &cloud, const std::vector<int> &indices) {
+    CloudT::Ptr extracted(new CloudT);
+    pcl::copyPointCloud(*cloud, indices, *extracted);
+    CloudNT expected;
+    pcl::NormalEstimation<PointT, pcl::Normal> ne;
+    ne.setSearchMethod(pcl::search::KdTree<PointT>::Ptr(new pcl::search::KdTree<PointT>));
+    ne.setKSearch(kSearch);
+    ne.setInputCloud(extracted);
+    ne.compute(expected);
+
+    size_t differing = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (!sameNormal(normals.points[indices[i]], expected.points[i])) {
+            differing++;
+        }
+    }
+    return differing;
+}
+
+size_t compareToExtracted(point_cloud_proc::NormalEngine<PointT> &engine, const CloudT::Ptr &cloud,
+                          const std::vector<int> &indices) {
+    pcl::PointIndices::Ptr view(new pcl::PointIndices);
+    view->indices = indices;
+    return compareToExtracted(*engine.compute(cloud, view), cloud, indices);
+}
+
+// Two calls from the same source share their normals, other index contents
+// of the same size or another transform recompute them without touching
+// the normals handed out before
+bool checkCache(point_cloud_proc::NormalEngine<PointT> &engine, const CloudT::Ptr &cloud,
+                const std::vector<int> &indices) {
+    point_cloud_proc::NormalSource source(boost::shared_ptr<int>(new int(0)), Eigen::Matrix4f::Identity());
+    pcl::PointIndices::Ptr view(new pcl::PointIndices);
+    view->indices = indices;
+
+    CloudNT::ConstPtr first = engine.compute(cloud, view, source);
+    CloudNT kept = *first;
+    if (engine.compute(cloud, view, source) != first) {
+        std::cout << "  same source recomputed" << std::endl;
+        return false;
+    }
+
+    // Swap one tabletop point for the first point that is not on it
+    pcl::PointIndices::Ptr other(new pcl::PointIndices);
+    other->indices = indices;
+    int outside = 0;
+    while (std::binary_search(indices.begin(), indices.end(), outside)) {
+        outside++;
+    }
+    other->indices.front() = outside;
+    std::sort(other->indices.begin(), other->indices.end());
+    CloudNT::ConstPtr second = engine.compute(cloud, other, source);
+    if (second == first || compareToExtracted(*second, cloud, other->indices) > 0) {
+        std::cout << "  other indices of the same size hit the cache" << std::endl;
+        return false;
+    }
+
+    point_cloud_proc::NormalSource moved = source;
+    moved.transform(0, 3) = 0.1f;
+    engine.compute(cloud, other, source);
+    if (engine.compute(cloud, other, moved) == second) {
+        std::cout << "  other transform hit the cache" << std::endl;
+        return false;
+    }
+
+    if (compareToExtracted(*first, cloud, indices) > 0 || compareToExtracted(kept, cloud, indices) > 0) {
+        std::cout << "  normals handed out were modified" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    int num_scenes = argc > 1 ? std::stoi(argv[1]) : 10;
+    unsigned int seed = argc > 2 ? std::stoul(argv[2]) : 42;
+
+    point_cloud_proc::NormalEngine<PointT> engine;
+    engine.setKSearch(kSearch);
+
+    std::mt19937 rng(seed);
+    CloudT::Ptr cloud(new CloudT), organized(new CloudT);
+    std::vector<int> tabletop, clustered;
+    int failed = 0;
+
+    for (int scene = 0; scene < num_scenes; scene++) {
+        makeScene(rng, *cloud, tabletop);
+        clustered = tabletop;
+        makeOrganized(*cloud, clustered, *organized);
+
+        size_t differing = compareToExtracted(engine, cloud, tabletop);
+        size_t differing_organized = compareToExtracted(engine, organized, clustered);
+        bool cache_ok = checkCache(engine, cloud, tabletop);
+        std::cout << "scene " << scene << ": tabletop " << (differing == 0 ? "ok" : "FAILED")
+                  << ", organized " << (differing_organized == 0 ? "ok" : "FAILED")
+                  << ", cache " << (cache_ok ? "ok" : "FAILED")
+                  << ", " << differing + differing_organized << " of " << 2 * tabletop.size()
+                  << " normals differ" << std::endl;
+        if (differing > 0 || differing_organized > 0 || !cache_ok) {
+            failed++;
+        }
+    }
+
+    std::cout << failed << " of " << num_scenes << " scenes differ" << std::endl;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include <point_cloud_proc/plane_tracker.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// PlaneTracker on a table whose visible extent moves from frame to frame,
+// like a table the camera pans over, while a share of its points stays
+// hidden. Every frame has to be tracked with a stale hull, which the caller
+// refreshes with updateHull() the way segmentPlane() does, and the refreshed
+// hull has to fit the same frame again. The refresh must not lower the
+// inlier count tracked frames are compared against: a last frame with less
+// than min_inlier_ratio of the RANSAC inliers has to fail, even though it
+// has enough of the inliers of the frames before it.
+//
+// usage: test_plane_tracker [num_runs] [seed]
+// Returns non zero when a run fails.
+
+typedef point_cloud_proc::PlaneTracker::PointT PointT;
+typedef point_cloud_proc::PlaneTracker::CloudT CloudT;
+
+const float kTableZ = 0.7f;
+const float kMinInlierRatio = 0.8f;
+const size_t kTablePoints = 10000;
+
+// num_points noisy table points from x to x + 0.8, and clutter above
+void makeFrame(float x, size_t num_points, std::mt19937 &rng, CloudT &cloud, std::vector<int> &table) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+
+    cloud.clear();
+    table.clear();
+    for (size_t i = 0; i < num_points; i++) {
+        PointT point;
+        point.x = x + 0.8f * unit(rng);
+        point.y = -0.4f + 0.8f * unit(rng);
+        point.z = kTableZ + noise(rng);
+        table.push_back(static_cast<int>(cloud.points.size()));
+        cloud.push_back(point);
+    }
+    for (int i = 0; i < 500; i++) {
+        PointT point;
+        point.x = x + 0.8f * unit(rng);
+        point.y = -0.4f + 0.8f * unit(rng);
+        point.z = kTableZ + 0.05f + 0.3f * unit(rng);
+        cloud.push_back(point);
+    }
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+// The corners of the extent of the points in indices, a stand in for the
+// hull the caller computes
+void makeHull(const CloudT &cloud, const std::vector<int> &indices, CloudT &hull) {
+    PointT min_pt = cloud.points[indices[0]], max_pt = min_pt;
+    for (int index : indices) {
+        min_pt.x = std::min(min_pt.x, cloud.points[index].x);
+        min_pt.y = std::min(min_pt.y, cloud.points[index].y);
+        max_pt.x = std::max(max_pt.x, cloud.points[index].x);
+        max_pt.y = std::max(max_pt.y, cloud.points[index].y);
+    }
+    hull.clear();
+    hull.push_back(min_pt);
+    hull.push_back(max_pt);
+}
+
+bool runFrames(std::mt19937 &rng) {
+    point_cloud_proc::PlaneTracker tracker;
+    tracker.setMinInlierRatio(kMinInlierRatio);
+    const Eigen::Vector3f axis(0.0f, 0.0f, 1.0f);
+
+    CloudT cloud, hull;
+    std::vector<int> table;
+    pcl::PointIndices inliers;
+    pcl::ModelCoefficients coefficients;
+    coefficients.values = {0.0f, 0.0f, 1.0f, -kTableZ};
+
+    // The plane RANSAC found in the first frame
+    makeFrame(0.4f, kTablePoints, rng, cloud, table);
+    makeHull(cloud, table, hull);
+    tracker.update(cloud, table, coefficients, axis, hull);
+
+    // The camera pans, a tenth of the table is hidden
+    for (int frame = 1; frame <= 5; frame++) {
+        makeFrame(0.4f + 0.05f * frame, kTablePoints * 9 / 10, rng, cloud, table);
+        if (!tracker.track(cloud, axis, inliers, coefficients)) {
+            std::cout << "  frame " << frame << " not tracked" << std::endl;
+            return false;
+        }
+        if (tracker.hullValid()) {
+            std::cout << "  frame " << frame << " kept the hull of a moved extent" << std::endl;
+            return false;
+        }
+        makeHull(cloud, inliers.indices, hull);
+        tracker.updateHull(cloud, inliers.indices, hull);
+
+        if (!tracker.track(cloud, axis, inliers, coefficients) || !tracker.hullValid()) {
+            std::cout << "  frame " << frame << " does not fit its refreshed hull" << std::endl;
+            return false;
+        }
+    }
+
+    // Enough of the 90 % tracked above, too few of the RANSAC inliers
+    makeFrame(0.65f, kTablePoints * 3 / 4, rng, cloud, table);
+    if (tracker.track(cloud, axis, inliers, coefficients)) {
+        std::cout << "  tracked " << inliers.indices.size() << " of " << kTablePoints
+                  << " RANSAC inliers, the hull refresh lowered the reference" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+
+    int num_runs = argc > 1 ? std::stoi(argv[1]) : 10;
+    unsigned int seed = argc > 2 ? std::stoul(argv[2]) : 42;
+
+    std::mt19937 rng(seed);
+    int failed = 0;
+    for (int run = 0; run < num_runs; run++) {
+        bool ok = runFrames(rng);
+        std::cout << "run " << run << ": " << (ok ? "ok" : "FAILED") << std::endl;
+        if (!ok) {
+            failed++;
+        }
+    }
+
+    std::cout << failed << " of " << num_runs << " runs failed" << std::endl;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+#include <point_cloud_proc/point_kernels.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// The scalar, SSE4.1 and AVX2 variants of transformCropPoints() on the same
+// points have to give bit for bit the same coordinates, keep flags and
+// counts. The points include NaNs, points on the box bounds and sizes that
+// leave a tail for the scalar loop. Levels the CPU does not support fall
+// back to the best one it has and are reported as such.
+//
+// usage: test_point_kernels [num_sizes] [seed]
+// Returns non zero when a variant differs from the scalar one.
+
+struct Points {
+    std::vector<float> x, y, z;
+    std::vector<uint8_t> keep;
+    size_t kept;
+};
+
+void makePoints(size_t n, const float *box, std::mt19937 &rng, Points &points) {
+    std::uniform_real_distribution<float> coordinate(-3.0f, 3.0f);
+    std::uniform_int_distribution<int> kind(0, 19);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    points.x.resize(n);
+    points.y.resize(n);
+    points.z.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        points.x[i] = coordinate(rng);
+        points.y[i] = coordinate(rng);
+        points.z[i] = coordinate(rng);
+        switch (kind(rng)) {
+            case 0:
+                points.x[i] = nan;
+                break;
+            case 1:
+                points.z[i] = nan;
+                break;
+            case 2:
+                // On a bound before the transform, the identity keeps it there
+                points.x[i] = box[kind(rng) % 2];
+                break;
+            default:
+                break;
+        }
+    }
+    points.keep.assign(n, 2);
+}
+
+bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+bool runMatrix(const float *m, const float *box, size_t n, std::mt19937 &rng) {
+
+    Points input;
+    makePoints(n, box, rng, input);
+
+    const point_cloud_proc::SimdLevel levels[3] = {point_cloud_proc::SIMD_SCALAR, point_cloud_proc::SIMD_SSE4,
+                                                   point_cloud_proc::SIMD_AVX2};
+    Points results[3];
+    for (int l = 0; l < 3; l++) {
+        results[l] = input;
+        results[l].kept = point_cloud_proc::transformCropPoints(levels[l], results[l].x.data(), results[l].y.data(),
+                                                                results[l].z.data(), n, m, box,
+                                                                results[l].keep.data());
+    }
+
+    bool ok = true;
+    for (int l = 1; l < 3; l++) {
+        const Points &scalar = results[0], &simd = results[l];
+        if (simd.kept != scalar.kept || simd.keep != scalar.keep ||
+            !sameBits(simd.x, scalar.x) || !sameBits(simd.y, scalar.y) || !sameBits(simd.z, scalar.z)) {
+            std::cout << "  " << point_cloud_proc::simdLevelName(levels[l]) << " differs from scalar for "
+                      << n << " points, kept " << simd.kept << " instead of " << scalar.kept << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+
+    int num_sizes = argc > 1 ? std::stoi(argv[1]) : 40;
+    unsigned int seed = argc > 2 ? std::stoul(argv[2]) : 42;
+
+    std::cout << "best level: " << point_cloud_proc::simdLevelName(point_cloud_proc::simdLevel()) << std::endl;
+
+    const float box[6] = {-1.0f, 1.5f, -1.2f, 1.2f, -0.1f, 2.0f};
+    const float identity[12] = {1.0f, 0.0f, 0.0f, 0.0f,
+                                0.0f, 1.0f, 0.0f, 0.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f};
+    // A camera looking down at a table, rotation and translation
+    const float camera[12] = {0.0f, -0.5f, 0.8660254f, 0.1f,
+                              -1.0f, 0.0f, 0.0f, 0.02f,
+                              0.0f, -0.8660254f, -0.5f, 1.1f};
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> size(0, 20000);
+    int failed = 0;
+    for (int i = 0; i < num_sizes; i++) {
+        // The first sizes cover the tails of the vector loops
+        size_t n = i < 20 ? static_cast<size_t>(i) : size(rng);
+        if (!runMatrix(identity, box, n, rng) || !runMatrix(camera, box, n, rng)) {
+            failed++;
+        }
+    }
+
+    std::cout << failed << " of " << num_sizes << " sizes differ" << std::endl;
+    return failed > 0 ? 1 : 0;
+}